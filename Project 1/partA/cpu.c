@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 
 #include "cpu.h"
 
@@ -21,6 +22,68 @@ int ENABLE_DISPLAY;
 /* Flag to enable counting code_memory_size by the implemented logic */
 int ENABLE_COUNTING;
 
+/* Returns the words of a page, allocating it if asked to, NULL if missing */
+static int*
+get_data_page(DATA_MEMORY* memory, int page, int allocate)
+{
+  int*** table = &memory->directory[page / PAGE_TABLE_SIZE];
+  if (!*table && allocate) {
+    *table = calloc(PAGE_TABLE_SIZE, sizeof(int*));
+  }
+  if (!*table) {
+    return NULL;
+  }
+  int** words = &(*table)[page % PAGE_TABLE_SIZE];
+  if (!*words && allocate) {
+    *words = calloc(PAGE_WORDS, sizeof(int));
+  }
+  if (allocate && !*words) {
+    fprintf(stderr, "APEX_Error : Unable to allocate data memory\n");
+    exit(1);
+  }
+  return *words;
+}
+
+/* Words that were never written read as 0 */
+static int
+read_data_memory(DATA_MEMORY* memory, int address)
+{
+  int page = address / PAGE_WORDS;
+  if (page != memory->tlb_page) {
+    int* words = get_data_page(memory, page, 0);
+    if (!words) {
+      return 0;
+    }
+    memory->tlb_page = page;
+    memory->tlb_words = words;
+  }
+  return memory->tlb_words[address % PAGE_WORDS];
+}
+
+static void
+write_data_memory(DATA_MEMORY* memory, int address, int value)
+{
+  int page = address / PAGE_WORDS;
+  if (page != memory->tlb_page) {
+    memory->tlb_page = page;
+    memory->tlb_words = get_data_page(memory, page, 1);
+  }
+  memory->tlb_words[address % PAGE_WORDS] = value;
+}
+
+static void
+free_data_memory(DATA_MEMORY* memory)
+{
+  for (int i = 0; i < PAGE_DIRECTORY_SIZE; i++) {
+    if (memory->directory[i]) {
+      for (int j = 0; j < PAGE_TABLE_SIZE; j++) {
+        free(memory->directory[i][j]);
+      }
+      free(memory->directory[i]);
+    }
+  }
+}
+
 /*
  * This function creates and initializes APEX cpu.
  *
@@ -56,10 +119,13 @@ APEX_cpu_init(const char* filename, const char* function, const int cycles)
   }
   /*memset(cpu->regs_valid, 1, sizeof(int) * 16);*/
   memset(cpu->stage, 0, sizeof(CPU_Stage) * NUM_STAGES);
-  memset(cpu->data_memory, 0, sizeof(int) * 4000);
+  cpu->log = NULL;
+  memset(&cpu->memory, 0, sizeof(cpu->memory));
+  cpu->memory.tlb_page = -1;
 
   /* Parse input file and create code memory */
   cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
+  cpu->code_memory_length = cpu->code_memory_size;
 
   /* Making Z flag invalid for the first branch instruction */
   cpu->z_flag_valid = 1;
@@ -108,10 +174,53 @@ APEX_cpu_init(const char* filename, const char* function, const int cycles)
 void
 APEX_cpu_stop(APEX_CPU* cpu)
 {
+  flush_trace_log(cpu);
+  free(cpu->log);
+  free_data_memory(&cpu->memory);
   free(cpu->code_memory);
   free(cpu);
 }
 
+/*
+ * Appends a message of TRACE to the trace log of the CPU. The log is
+ * written to stderr in one piece whenever it fills up.
+ */
+void
+trace_message(APEX_CPU* cpu, const char* format, ...)
+{
+  if (!cpu->log) {
+    cpu->log = calloc(1, sizeof(TRACE_LOG));
+    if (!cpu->log) {
+      return;
+    }
+  }
+  TRACE_LOG* log = cpu->log;
+  if (log->fill + TRACE_MESSAGE_SIZE > TRACE_LOG_SIZE) {
+    flush_trace_log(cpu);
+  }
+
+  char* out = log->buffer + log->fill;
+  va_list args;
+  va_start(args, format);
+  int length = snprintf(out, TRACE_MESSAGE_SIZE, "%6d ", cpu->clock);
+  length += vsnprintf(out + length, TRACE_MESSAGE_SIZE - length, format, args);
+  va_end(args);
+  if (length > TRACE_MESSAGE_SIZE - 1) {
+    length = TRACE_MESSAGE_SIZE - 1;
+  }
+  out[length] = '\n';
+  log->fill += length + 1;
+}
+
+void
+flush_trace_log(APEX_CPU* cpu)
+{
+  if (cpu->log && cpu->log->fill) {
+    fwrite(cpu->log->buffer, 1, cpu->log->fill, stderr);
+    cpu->log->fill = 0;
+  }
+}
+
 /* Converts the PC(4000 series) into
  * array index for code memory
  *
@@ -194,19 +303,19 @@ display(APEX_CPU* cpu)
 
   printf("\n\n========== STATE OF DATA MEMORY ==========\n\n");
   for(int i = 0; i < 100; i++) {
-    printf("|\tMEM[%d]\t|\tData Value = %d\t|\n", i, cpu->data_memory[i]);
+    printf("|\tMEM[%d]\t|\tData Value = %d\t|\n", i, read_data_memory(&cpu->memory, i));
   }
 }
 
 /*  Exception handler
- *  Key 0 - computed effective memory address is not in the range of 0 - 4096
+ *  Key 0 - computed effective memory address is negative
  *  Key 1 - Invalid input register
  */
 int
 exception_handler(int code, char* opcode)
 {
   switch(code) {
-    case 0: printf("ERROR >> Computed effective memory address for %s is out of 4096 memory range size\n", opcode);
+    case 0: printf("ERROR >> Computed effective memory address for %s is out of memory range\n", opcode);
             exit(1);
             break;
 
@@ -276,7 +385,13 @@ fetch(APEX_CPU* cpu)
     /* Index into code memory using this pc and copy all instruction fields into
      * fetch latch
      */
-    APEX_Instruction* current_ins = &cpu->code_memory[get_code_index(cpu->pc)];
+    /* Past the end of the program an empty instruction is fetched */
+    static APEX_Instruction no_instruction;
+    int index = get_code_index(cpu->pc);
+    APEX_Instruction* current_ins = &no_instruction;
+    if (index >= 0 && index < cpu->code_memory_length) {
+      current_ins = &cpu->code_memory[index];
+    }
     strcpy(stage->opcode, current_ins->opcode);
     stage->rd = current_ins->rd;
     stage->rs1 = current_ins->rs1;
@@ -527,7 +642,7 @@ execute(APEX_CPU* cpu)
     /* STORE */
     if (strcmp(stage->opcode, "STORE") == 0) {
       stage->mem_address = stage->rs2_value + stage->imm;
-      if (stage->mem_address > 4096 || stage->mem_address < 0) {
+      if (stage->mem_address < 0) {
         exception_handler(0, stage->opcode);
       }
     }
@@ -535,7 +650,7 @@ execute(APEX_CPU* cpu)
      /* LOAD */
     if (strcmp(stage->opcode, "LOAD") == 0) {
       stage->mem_address = stage->rs1_value + stage->imm;
-      if (stage->mem_address > 4096 || stage->mem_address < 0) {
+      if (stage->mem_address < 0) {
         exception_handler(0, stage->opcode);
       }
     }
@@ -647,12 +762,12 @@ memory(APEX_CPU* cpu)
 
     /* STORE */
     if (strcmp(stage->opcode, "STORE") == 0) {
-      cpu->data_memory[stage->mem_address] = stage->rs1_value;
+      write_data_memory(&cpu->memory, stage->mem_address, stage->rs1_value);
     }
 
     /* LOAD */
     if (strcmp(stage->opcode, "LOAD") == 0) {
-      stage->buffer = cpu->data_memory[stage->mem_address];
+      stage->buffer = read_data_memory(&cpu->memory, stage->mem_address);
     }
 
     /* Copy data from decode latch to execute latch*/
@@ -690,7 +805,7 @@ writeback(APEX_CPU* cpu)
         strcmp(stage->opcode, "EX-OR") == 0 ||
         strcmp(stage->opcode, "LOAD") == 0 ||
         strcmp(stage->opcode, "MUL") == 0) {
-      printf("%d", stage->buffer);
+      TRACE(cpu, TRACE_WRITEBACK, 1, "R%d = %d", stage->rd, stage->buffer);
       cpu->regs[stage->rd] = stage->buffer;
 
       /*  Check whether there is an instruction in EX or MEM stage using the same destination register
@@ -18,6 +18,35 @@ enum
   NUM_STAGES
 };
 
+#define PAGE_WORDS 1024
+#define PAGE_TABLE_SIZE 1024
+#define PAGE_DIRECTORY_SIZE 2048
+
+/* Compile-time trace level and categories, e.g. make TRACE_LEVEL=2.
+ * With level 0 every TRACE compiles to nothing.
+ */
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL 0
+#endif
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES 0xff
+#endif
+
+#define TRACE_FORWARD 0x01
+#define TRACE_EXECUTE 0x02
+#define TRACE_MEMORY 0x04
+#define TRACE_WRITEBACK 0x08
+
+#define TRACE_LOG_SIZE (1 << 16)
+#define TRACE_MESSAGE_SIZE 256
+
+#define TRACE(cpu, category, level, ...) \
+  do { \
+    if (TRACE_LEVEL >= (level) && (TRACE_CATEGORIES & (category))) { \
+      trace_message((cpu), __VA_ARGS__); \
+    } \
+  } while (0)
+
 /* Format of an APEX instruction  */
 typedef struct APEX_Instruction
 {
@@ -46,6 +75,23 @@ typedef struct CPU_Stage
   int stalled;		// Flag to indicate, stage is stalled
 } CPU_Stage;
 
+/* Sparse data memory of word addresses 0 - 2^31-1. Pages of PAGE_WORDS
+ * words are allocated when a word in them is first written.
+ */
+typedef struct DATA_MEMORY
+{
+  int** directory[PAGE_DIRECTORY_SIZE];    // page tables, NULL until used
+  int tlb_page;    // page of the last translation, -1 if none
+  int* tlb_words;
+} DATA_MEMORY;
+
+/* Buffer of trace messages, written out in large pieces */
+typedef struct TRACE_LOG
+{
+  char buffer[TRACE_LOG_SIZE];
+  int fill;
+} TRACE_LOG;
+
 /* Model of APEX CPU */
 typedef struct APEX_CPU
 {
@@ -68,13 +114,17 @@ typedef struct APEX_CPU
   /* Code Memory where instructions are stored */
   APEX_Instruction* code_memory;
   int code_memory_size;
+  int code_memory_length;    // instructions loaded, code_memory_size is reused as the cycle count
 
   /* Data Memory */
-  int data_memory[4096];
+  DATA_MEMORY memory;
 
   /* Some stats */
   int ins_completed;
 
+  /* Messages of TRACE, allocated by the first one */
+  struct TRACE_LOG* log;
+
 } APEX_CPU;
 
 APEX_Instruction*
@@ -83,6 +133,12 @@ create_code_memory(const char* filename, int* size);
 APEX_CPU*
 APEX_cpu_init(const char* filename, const char* function, const int cycles);
 
+void
+trace_message(APEX_CPU* cpu, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+void
+flush_trace_log(APEX_CPU* cpu);
+
 int
 get_source_values(APEX_CPU* cpu, int rs2_exist);
 
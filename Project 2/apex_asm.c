@@ -0,0 +1,55 @@
+/*
+ *  apex_asm.c
+ *  Assembles an APEX program into an object file, see object_driver.c
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "object_driver.h"
+#include "memory_driver.h"
+
+int
+main(int argc, char const* argv[])
+{
+  if (argc != 3) {
+    fprintf(stderr, "APEX_Help : Usage %s <input_file> <object_file>\n", argv[0]);
+    exit(1);
+  }
+
+  int size = 0;
+  static DATA_MEMORY memory;
+  init_data_memory(&memory);
+  DATA_SEGMENT data = { 0, 0, &memory };
+  APEX_Instruction* code_memory = create_code_memory(argv[1], &size, &data, NULL);
+  if (!code_memory) {
+    fprintf(stderr, "APEX_Error : Unable to read program %s\n", argv[1]);
+    exit(1);
+  }
+
+  /* The object file holds the data segment as one block */
+  int data_size = data.end - data.start;
+  int* words = malloc(sizeof(int) * (data_size + 1));
+  if (!words) {
+    fprintf(stderr, "APEX_Error : Unable to allocate data segment of %d words\n", data_size);
+    exit(1);
+  }
+  for (int i = 0; i < data_size; i++) {
+    words[i] = read_memory(&memory, data.start + i);
+  }
+
+  int result = write_object_file(argv[2], code_memory, size, words, data.start, data_size);
+  free(words);
+  free(code_memory);
+  free_data_memory(&memory);
+  if (result) {
+    exit(1);
+  }
+  fprintf(stderr, "APEX_ASM : Assembled %d instructions into %s\n", size, argv[2]);
+  return 0;
+}
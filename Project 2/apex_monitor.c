@@ -0,0 +1,142 @@
+/*
+ *  apex_monitor.c
+ *  Prints the progress of a simulator run started with --live-stats, see
+ *  live_driver.c
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "cpu.h"
+#include "live_driver.h"
+
+typedef struct LIVE_SAMPLE
+{
+  long clock;
+  long committed;
+  long flushes;
+  long occupancy[NUM_OCC_QUEUES];
+  double time;    // host seconds
+} LIVE_SAMPLE;
+
+static double
+host_seconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void
+read_sample(LIVE_STATS* stats, LIVE_SAMPLE* sample)
+{
+  sample->clock = atomic_load_explicit(&stats->clock, memory_order_relaxed);
+  sample->committed = atomic_load_explicit(&stats->committed, memory_order_relaxed);
+  sample->flushes = atomic_load_explicit(&stats->flushes, memory_order_relaxed);
+  for (int s = 0; s < NUM_OCC_QUEUES; s++) {
+    sample->occupancy[s] = atomic_load_explicit(&stats->occupancy[s], memory_order_relaxed);
+  }
+  sample->time = host_seconds();
+}
+
+/* Prints the totals of the run and the rates since the previous sample */
+static void
+print_sample(LIVE_STATS* stats, LIVE_SAMPLE* now, LIVE_SAMPLE* last)
+{
+  long max_cycles = atomic_load_explicit(&stats->max_cycles, memory_order_relaxed);
+  long cycles = now->clock - last->clock;
+  double seconds = now->time - last->time;
+
+  printf("cycle %ld of %ld (%.1f%%) |\tcommitted %ld |\tIPC %.3f",
+         now->clock, max_cycles, max_cycles ? 100.0 * now->clock / max_cycles : 0.0,
+         now->committed, now->clock ? (double)now->committed / now->clock : 0.0);
+  if (cycles > 0) {
+    printf(" (%.3f now)", (double)(now->committed - last->committed) / cycles);
+  }
+  printf(" |\tflushes %ld |\t", now->flushes);
+
+  /* Mean occupancy since the previous sample, or of the whole run before the first one */
+  const char* names[NUM_OCC_QUEUES] = {"IQ", "ROB", "LSQ"};
+  long span = cycles > 0 ? cycles : now->clock;
+  for (int s = 0; s < NUM_OCC_QUEUES; s++) {
+    long used = now->occupancy[s] - (cycles > 0 ? last->occupancy[s] : 0);
+    printf("%s %.2f ", names[s], span ? (double)used / span : 0.0);
+  }
+  if (cycles > 0 && seconds > 0) {
+    printf("|\t%.0f cycles/s", cycles / seconds);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+int
+main(int argc, char const* argv[])
+{
+  if (argc != 2 && argc != 3) {
+    fprintf(stderr, "APEX_Help : Usage %s <name> [<milliseconds between updates>]\n", argv[0]);
+    exit(1);
+  }
+  int period = argc == 3 ? atoi(argv[2]) : 1000;
+  if (period <= 0) {
+    period = 1000;
+  }
+
+  char name[256];
+  snprintf(name, sizeof(name), "%s%s", argv[1][0] == '/' ? "" : "/", argv[1]);
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    fprintf(stderr, "APEX_Error : No simulator publishes %s\n", name);
+    exit(1);
+  }
+  LIVE_STATS* stats = mmap(NULL, sizeof(LIVE_STATS), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (stats == MAP_FAILED) {
+    fprintf(stderr, "APEX_Error : Unable to map %s\n", name);
+    exit(1);
+  }
+  if (memcmp(stats->magic, LIVE_MAGIC, sizeof(stats->magic)) != 0 || stats->version != LIVE_VERSION) {
+    fprintf(stderr, "APEX_Error : %s is not a page of this simulator version\n", name);
+    exit(1);
+  }
+  atomic_thread_fence(memory_order_acquire);
+  printf("APEX_MONITOR : %s, simulator process %d\n", stats->program, stats->pid);
+
+  LIVE_SAMPLE last;
+  read_sample(stats, &last);
+  print_sample(stats, &last, &last);
+  while (atomic_load_explicit(&stats->state, memory_order_relaxed) != LIVE_FINISHED) {
+    struct timespec delay = {period / 1000, (period % 1000) * 1000000L};
+    nanosleep(&delay, NULL);
+
+    if (atomic_load_explicit(&stats->state, memory_order_relaxed) != LIVE_FINISHED &&
+        kill(stats->pid, 0) != 0 && errno == ESRCH) {
+      fprintf(stderr, "APEX_Error : Simulator process %d exited without finishing the run\n", stats->pid);
+      exit(1);
+    }
+    LIVE_SAMPLE now;
+    read_sample(stats, &now);
+    if (now.clock != last.clock) {
+      print_sample(stats, &now, &last);
+      last = now;
+    }
+  }
+
+  LIVE_SAMPLE now;
+  read_sample(stats, &now);
+  if (now.clock != last.clock) {
+    print_sample(stats, &now, &last);
+  }
+  printf("APEX_MONITOR : run finished at cycle %ld\n", now.clock);
+  munmap(stats, sizeof(LIVE_STATS));
+  return 0;
+}
@@ -7,6 +7,7 @@
 #include "iq_driver.h"
 #include "lsq_driver.h"
 #include "branch_driver.h"
+#include "pipeview_driver.h"
 
 int
 is_bis_entry_free(APEX_CPU* cpu)
@@ -60,6 +61,9 @@ flush_FUs(APEX_CPU* cpu, int branch_id, enum STAGES FU_type)
 void
 flush_fetch_decode(APEX_CPU* cpu)
 {
+  if (cpu->pipeview.file) {
+    write_flushed_stages(cpu);
+  }
   strcpy(cpu->stage[F].opcode, "");
   strcpy(cpu->stage[DRF].opcode, "");
   cpu->stage[F].stalled = 1;
@@ -0,0 +1,340 @@
+/*
+ *  callstack_driver.c
+ *  Cycles of the program by call stack, written as folded stacks
+ *
+ *  A shadow call stack follows the committed instructions. A JAL pushes a
+ *  frame, whose subroutine is the instruction committed after it, and a JUMP
+ *  through the register the JAL of the top frame linked into pops it. JUMPs
+ *  through other registers are plain jumps. Beyond CALL_STACK_DEPTH frames
+ *  the deeper ones are only counted, their cycles go to the deepest frame
+ *  kept, and any JUMP returns from them.
+ *
+ *  Every distinct stack is a node of the call graph, a tree of the frames
+ *  entered from each frame. The cycles of the run are charged at the end of
+ *  every simulated cycle to the node of the stack of that cycle, so they add
+ *  up to the cycles of the run. At the end one line per stack that was
+ *  charged is written in the folded format read by flamegraph.pl, speedscope
+ *  and similar tools:
+ *
+ *    main;sum;square 120
+ *
+ *  Frames are named by the label of their first instruction in the source,
+ *  or by its PC. The bottom frame is the code outside of any subroutine,
+ *  starting at the first instruction of the program.
+ *
+ *  The stack is part of APEX_CPU, so debug mode and checkpoints take it back
+ *  and forth with the pipeline. The cycles live outside of it, like the
+ *  counters of the profile, and cycles simulated again in debug mode are
+ *  charged again.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "cpu.h"
+#include "callstack_driver.h"
+
+typedef struct CALL_NODE
+{
+  int entry;    // PC of the first instruction of the frame
+  int parent;    // node of the stack without this frame, -1 for the bottom one
+  int child;    // first node entered from this one, -1 if none
+  int sibling;    // next node entered from the parent
+  int depth;
+  long cycles;
+  long loop_mark;    // cycles at the last loop head
+  long loop_period;    // cycles of the last loop iteration
+} CALL_NODE;
+
+typedef struct CALL_GRAPH
+{
+  FILE* file;
+  const char* filename;
+  const char* source;    // source of the program, for the labels
+  CALL_NODE* nodes;    // node 0 is the bottom frame
+  int nodes_number;
+  int capacity;
+} CALL_GRAPH;
+
+/* Returns the node of the frame entered at entry from parent, adding it if it is new */
+static int
+get_child(CALL_GRAPH* graph, int parent, int entry)
+{
+  int* link = parent == -1 ? NULL : &graph->nodes[parent].child;
+  for (; link && *link != -1; link = &graph->nodes[*link].sibling) {
+    if (graph->nodes[*link].entry == entry) {
+      return *link;
+    }
+  }
+
+  if (graph->nodes_number == graph->capacity) {
+    int capacity = graph->capacity ? 2 * graph->capacity : 64;
+    CALL_NODE* nodes = realloc(graph->nodes, capacity * sizeof(CALL_NODE));
+    if (!nodes) {
+      fprintf(stderr, "APEX_Error : Unable to allocate the call graph\n");
+      exit(1);
+    }
+    graph->nodes = nodes;
+    graph->capacity = capacity;
+    /* realloc may have moved the link */
+    link = parent == -1 ? NULL : &graph->nodes[parent].child;
+    while (link && *link != -1) {
+      link = &graph->nodes[*link].sibling;
+    }
+  }
+
+  int node = graph->nodes_number++;
+  memset(&graph->nodes[node], 0, sizeof(CALL_NODE));
+  graph->nodes[node].entry = entry;
+  graph->nodes[node].parent = parent;
+  graph->nodes[node].child = -1;
+  graph->nodes[node].sibling = -1;
+  graph->nodes[node].depth = parent == -1 ? 0 : graph->nodes[parent].depth + 1;
+  if (link) {
+    *link = node;
+  }
+  return node;
+}
+
+int
+start_call_stacks(APEX_CPU* cpu, const char* source, const char* filename)
+{
+  CALL_GRAPH* graph = calloc(1, sizeof(CALL_GRAPH));
+  if (!graph) {
+    fprintf(stderr, "APEX_Error : Unable to allocate the call graph\n");
+    return -1;
+  }
+  graph->file = fopen(filename, "w");
+  if (!graph->file) {
+    fprintf(stderr, "APEX_Error : Unable to open call stacks file %s\n", filename);
+    free(graph);
+    return -1;
+  }
+  graph->filename = filename;
+  graph->source = source;
+  get_child(graph, -1, 4000);
+
+  cpu->call_graph = graph;
+  memset(&cpu->call_stack, 0, sizeof(cpu->call_stack));
+  return 0;
+}
+
+void
+free_call_stacks(APEX_CPU* cpu)
+{
+  if (!cpu->call_graph) {
+    return;
+  }
+  if (cpu->call_graph->file) {
+    fclose(cpu->call_graph->file);
+  }
+  free(cpu->call_graph->nodes);
+  free(cpu->call_graph);
+  cpu->call_graph = NULL;
+}
+
+/* Returns the node of the current stack, walking the frames from the bottom if it is not known */
+static int
+get_stack_node(APEX_CPU* cpu)
+{
+  CALL_STACK* stack = &cpu->call_stack;
+  if (stack->node == -1) {
+    int frames = stack->depth < CALL_STACK_DEPTH ? stack->depth : CALL_STACK_DEPTH;
+    stack->node = 0;
+    for (int i = 0; i < frames && stack->frames[i].entry != -1; i++) {
+      stack->node = get_child(cpu->call_graph, stack->node, stack->frames[i].entry);
+    }
+  }
+  return stack->node;
+}
+
+/* Called as the instruction leaves the ROB */
+void
+call_stack_retired_entry(APEX_CPU* cpu, ROB_Entry* entry)
+{
+  CALL_STACK* stack = &cpu->call_stack;
+  int top = stack->depth - 1;
+
+  /* First instruction of the subroutine a JAL entered */
+  if (top >= 0 && top < CALL_STACK_DEPTH && stack->frames[top].entry == -1) {
+    stack->frames[top].entry = entry->pc;
+    stack->node = get_child(cpu->call_graph, get_stack_node(cpu), entry->pc);
+  }
+
+  if (strcmp(entry->opcode, "JAL") == 0) {
+    if (stack->depth < CALL_STACK_DEPTH) {
+      stack->frames[stack->depth].entry = -1;
+      stack->frames[stack->depth].link = entry->arch_rd;
+    }
+    stack->depth++;
+  }
+  else if (strcmp(entry->opcode, "JUMP") == 0 && stack->depth > 0) {
+    if (stack->depth > CALL_STACK_DEPTH) {
+      stack->depth--;
+    }
+    else if (entry->arch_rs1 == stack->frames[top].link) {
+      stack->depth--;
+      stack->node = cpu->call_graph->nodes[get_stack_node(cpu)].parent;
+    }
+  }
+}
+
+/* Called at the end of every simulated cycle, which holds for the given number of cycles */
+void
+call_stack_cycle(APEX_CPU* cpu, int cycles)
+{
+  cpu->call_graph->nodes[get_stack_node(cpu)].cycles += cycles;
+}
+
+/* Called at every loop head, so the cycles of the last iteration are known */
+void
+mark_loop_call_stacks(APEX_CPU* cpu)
+{
+  CALL_GRAPH* graph = cpu->call_graph;
+  for (int i = 0; i < graph->nodes_number; i++) {
+    graph->nodes[i].loop_period = graph->nodes[i].cycles - graph->nodes[i].loop_mark;
+    graph->nodes[i].loop_mark = graph->nodes[i].cycles;
+  }
+}
+
+/* Adds iterations skipped by the loop fast-forward like the last detailed one */
+void
+skip_loop_call_stacks(APEX_CPU* cpu, int iterations)
+{
+  CALL_GRAPH* graph = cpu->call_graph;
+  for (int i = 0; i < graph->nodes_number; i++) {
+    graph->nodes[i].cycles += graph->nodes[i].loop_period * iterations;
+  }
+}
+
+/*
+ * Reads the labels of the instructions from the source, labels[i] of the
+ * i-th one. A label names the instruction on its line, or on the next line
+ * with an instruction if nothing else follows it. Returns NULL if the source
+ * can not be read.
+ */
+static char**
+read_labels(CALL_GRAPH* graph, APEX_CPU* cpu)
+{
+  if (!cpu->code_lines) {
+    return NULL;
+  }
+  FILE* fp = fopen(graph->source, "r");
+  char** labels = fp ? calloc(cpu->code_memory_size, sizeof(char*)) : NULL;
+  if (!labels) {
+    if (fp) {
+      fclose(fp);
+    }
+    return NULL;
+  }
+
+  char* line = NULL;
+  size_t len = 0;
+  char* label = NULL;
+  int line_number = 0;
+  int index = 0;
+  while (index < cpu->code_memory_size && getline(&line, &len, fp) != -1) {
+    line_number++;
+    char* p = line;
+    while (isspace((unsigned char)*p)) {
+      p++;
+    }
+    char* name = p;
+    while (isalnum((unsigned char)*p) || *p == '_') {
+      p++;
+    }
+    if (p > name && *p == ':') {
+      free(label);
+      label = strndup(name, p - name);
+      p++;
+    }
+    else {
+      p = name;
+    }
+    while (isspace((unsigned char)*p)) {
+      p++;
+    }
+
+    if (line_number == cpu->code_lines[index]) {
+      labels[index++] = label;
+      label = NULL;
+    }
+    else if (*p == '.') {
+      /* A label of data or of a constant */
+      free(label);
+      label = NULL;
+    }
+  }
+  free(label);
+  free(line);
+  fclose(fp);
+  return labels;
+}
+
+static void
+write_frame_name(FILE* fp, APEX_CPU* cpu, char** labels, int pc)
+{
+  int index = get_code_index(pc);
+  if (labels && pc >= 4000 && index < cpu->code_memory_size && labels[index]) {
+    fputs(labels[index], fp);
+  }
+  else {
+    fprintf(fp, "%d", pc);
+  }
+}
+
+/* Writes the folded stacks and prints what was written */
+void
+display_call_stacks(APEX_CPU* cpu)
+{
+  CALL_GRAPH* graph = cpu->call_graph;
+  char** labels = read_labels(graph, cpu);
+  int path[CALL_STACK_DEPTH + 1];
+  int stacks = 0;
+  int deepest = 0;
+  long cycles = 0;
+
+  for (int i = 0; i < graph->nodes_number; i++) {
+    CALL_NODE* node = &graph->nodes[i];
+    if (node->depth > deepest) {
+      deepest = node->depth;
+    }
+    if (!node->cycles) {
+      continue;
+    }
+    int frames = 0;
+    for (int n = i; n != -1; n = graph->nodes[n].parent) {
+      path[frames++] = graph->nodes[n].entry;
+    }
+    while (frames--) {
+      write_frame_name(graph->file, cpu, labels, path[frames]);
+      fputc(frames ? ';' : ' ', graph->file);
+    }
+    fprintf(graph->file, "%ld\n", node->cycles);
+    stacks++;
+    cycles += node->cycles;
+  }
+  if (fflush(graph->file) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to write call stacks file %s\n", graph->filename);
+  }
+
+  if (labels) {
+    for (int i = 0; i < cpu->code_memory_size; i++) {
+      free(labels[i]);
+    }
+    free(labels);
+  }
+
+  printf("\n================================= CALL STACKS ==================================\n");
+  printf("         |\tStacks written\t\t|\t%d to %s\t|\n", stacks, graph->filename);
+  printf("         |\tCycles in stacks\t|\t%ld\t|\n", cycles);
+  printf("         |\tDistinct call paths\t|\t%d\t|\n", graph->nodes_number - 1);
+  printf("         |\tDeepest stack\t\t|\t%d\t|\n", deepest);
+  printf("================================================================================\n");
+}
@@ -0,0 +1,28 @@
+/*
+ *  callstack_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+int
+start_call_stacks(APEX_CPU* cpu, const char* source, const char* filename);
+
+void
+free_call_stacks(APEX_CPU* cpu);
+
+void
+call_stack_retired_entry(APEX_CPU* cpu, ROB_Entry* entry);
+
+void
+call_stack_cycle(APEX_CPU* cpu, int cycles);
+
+void
+mark_loop_call_stacks(APEX_CPU* cpu);
+
+void
+skip_loop_call_stacks(APEX_CPU* cpu, int iterations);
+
+void
+display_call_stacks(APEX_CPU* cpu);
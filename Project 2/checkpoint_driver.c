@@ -0,0 +1,372 @@
+/*
+ *  checkpoint_driver.c
+ *  Saving and restoring the complete simulator state
+ *
+ *  A checkpoint file holds a header, an image of APEX_CPU, the code memory and
+ *  the written pages of data memory. The image covers URF, RAT, R-RAT, IQ, ROB,
+ *  LSQ, BIS with its backup RATs, stage latches, PC and the scheduler, so a
+ *  restored run continues exactly where the saved one stopped. Host pointers
+ *  are cleared when saving and set again when restoring.
+ *
+ *  Restore maps the file privately, so the restored CPU and code memory live in
+ *  the mapping and pages are copied only when the simulation writes to them.
+ *  Data memory pages are copied out of the mapping.
+ *  The image is raw, so a checkpoint is only accepted by a simulator built with
+ *  the same structure layout.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cpu.h"
+#include "checkpoint_driver.h"
+#include "scheduler_driver.h"
+#include "memory_driver.h"
+#include "delta_driver.h"
+
+#define CHECKPOINT_MAGIC "APEXCKPT"
+#define CHECKPOINT_VERSION 2
+
+/* Alignment of sections in the file, enough for any member of APEX_CPU */
+#define CHECKPOINT_ALIGN 64
+
+typedef struct CHECKPOINT_HEADER
+{
+  char magic[8];
+  int version;
+  int cpu_size;    // sizeof(APEX_CPU) of the simulator that wrote the file
+  int instruction_size;    // sizeof(APEX_Instruction)
+  int code_memory_size;    // number of instructions
+  int pages_number;    // pages of data memory
+  long cpu_offset;
+  long code_offset;
+  long pages_offset;    // page records, each a page number followed by PAGE_WORDS words
+} CHECKPOINT_HEADER;
+
+static long
+align_offset(long offset)
+{
+  return (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+/*
+ * Writes the state of the CPU to filename. The file is written under a
+ * temporary name first, so an interrupted save leaves the previous checkpoint.
+ */
+int
+save_checkpoint(APEX_CPU* cpu, const char* filename)
+{
+  CHECKPOINT_HEADER header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.cpu_size = sizeof(APEX_CPU);
+  header.instruction_size = sizeof(APEX_Instruction);
+  header.code_memory_size = cpu->code_memory_size;
+  header.cpu_offset = align_offset(sizeof(header));
+  header.code_offset = align_offset(header.cpu_offset + sizeof(APEX_CPU));
+  header.pages_number = cpu->memory.pages_number;
+  header.pages_offset = align_offset(header.code_offset +
+                                     (long)cpu->code_memory_size * sizeof(APEX_Instruction));
+
+  APEX_CPU* image = malloc(sizeof(*image));
+  if (!image) {
+    fprintf(stderr, "APEX_Error : Unable to allocate checkpoint image\n");
+    return -1;
+  }
+  memcpy(image, cpu, sizeof(*image));
+  image->code_memory = NULL;
+  image->code_map = NULL;
+  image->code_map_size = 0;
+  image->code_lines = NULL;
+  image->profile = NULL;
+  image->call_graph = NULL;
+  init_data_memory(&image->memory);
+  init_data_memory(&image->interval.memory);
+  image->interval.state.memory = NULL;
+  image->interval.state.devices = NULL;
+  image->devices.input = NULL;
+  image->devices.output = NULL;
+  memset(&image->trace, 0, sizeof(image->trace));
+  image->pipeview.file = NULL;
+  image->chrome.file = NULL;
+  image->series.file = NULL;
+  image->live.stats = NULL;
+  image->log = NULL;
+  memset(&image->checkpoint, 0, sizeof(image->checkpoint));
+
+  char temp_name[4096];
+  snprintf(temp_name, sizeof(temp_name), "%s.tmp", filename);
+  FILE* fp = fopen(temp_name, "wb");
+  if (!fp) {
+    fprintf(stderr, "APEX_Error : Unable to open checkpoint file %s\n", temp_name);
+    free(image);
+    return -1;
+  }
+
+  int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+           fseek(fp, header.cpu_offset, SEEK_SET) == 0 &&
+           fwrite(image, sizeof(*image), 1, fp) == 1 &&
+           fseek(fp, header.code_offset, SEEK_SET) == 0 &&
+           fwrite(cpu->code_memory, sizeof(APEX_Instruction), cpu->code_memory_size, fp) ==
+             (size_t)cpu->code_memory_size &&
+           fseek(fp, header.pages_offset, SEEK_SET) == 0;
+  for (int page = next_memory_page(&cpu->memory, 0); ok && page != -1;
+       page = next_memory_page(&cpu->memory, page + 1)) {
+    ok = fwrite(&page, sizeof(page), 1, fp) == 1 &&
+         fwrite(get_memory_page(&cpu->memory, page, 0), sizeof(int), PAGE_WORDS, fp) == PAGE_WORDS;
+  }
+  ok = (fclose(fp) == 0) && ok;
+  free(image);
+
+  if (!ok || rename(temp_name, filename) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to write checkpoint file %s\n", filename);
+    remove(temp_name);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Saves a checkpoint if the periodic checkpoint interval has elapsed.
+ * Called between cycles.
+ */
+void
+periodic_checkpoint(APEX_CPU* cpu)
+{
+  CHECKPOINT* checkpoint = &cpu->checkpoint;
+  if (checkpoint->interval <= 0 || cpu->clock < checkpoint->next_clock) {
+    return;
+  }
+  save_checkpoint(cpu, checkpoint->filename);
+  checkpoint->next_clock = cpu->clock + checkpoint->interval;
+}
+
+static int
+is_valid_checkpoint(const CHECKPOINT_HEADER* header, long size, const char* filename)
+{
+  if (size < (long)sizeof(*header) ||
+      memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0) {
+    fprintf(stderr, "APEX_Error : %s is not a checkpoint file\n", filename);
+    return 0;
+  }
+  if (header->version != CHECKPOINT_VERSION) {
+    fprintf(stderr, "APEX_Error : Checkpoint %s has version %d, expected %d\n",
+            filename, header->version, CHECKPOINT_VERSION);
+    return 0;
+  }
+  if (header->cpu_size != sizeof(APEX_CPU) || header->instruction_size != sizeof(APEX_Instruction)) {
+    fprintf(stderr, "APEX_Error : Checkpoint %s was written by an incompatible simulator build\n", filename);
+    return 0;
+  }
+  if (header->cpu_offset % CHECKPOINT_ALIGN || header->code_offset % CHECKPOINT_ALIGN ||
+      header->cpu_offset + (long)sizeof(APEX_CPU) > size ||
+      header->code_offset + (long)header->code_memory_size * (long)sizeof(APEX_Instruction) > size ||
+      header->pages_number < 0 ||
+      (header->pages_number &&
+       header->pages_offset + header->pages_number * (long)sizeof(int) * (PAGE_WORDS + 1) > size)) {
+    fprintf(stderr, "APEX_Error : Checkpoint %s is truncated\n", filename);
+    return 0;
+  }
+  return 1;
+}
+
+/* The checkpoint has to be taken from the program the simulator was started with */
+static int
+is_same_program(const APEX_Instruction* code, int size, APEX_CPU* cpu)
+{
+  if (size != cpu->code_memory_size) {
+    return 0;
+  }
+  for (int i = 0; i < size; i++) {
+    if (code[i].opcode_id != cpu->code_memory[i].opcode_id ||
+        code[i].rd != cpu->code_memory[i].rd ||
+        code[i].rs1 != cpu->code_memory[i].rs1 ||
+        code[i].rs2 != cpu->code_memory[i].rs2 ||
+        code[i].imm != cpu->code_memory[i].imm) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void*
+read_file(int fd, long size)
+{
+  char* buffer = malloc(size);
+  long done = 0;
+  while (buffer && done < size) {
+    ssize_t count = read(fd, buffer + done, size - done);
+    if (count <= 0) {
+      free(buffer);
+      return NULL;
+    }
+    done += count;
+  }
+  return buffer;
+}
+
+/*
+ * Restores the state saved in filename. Options of the current run (cycles
+ * to simulate, loop fast-forwarding, scheduler, checkpointing) are taken from
+ * cpu, which is released on success. Returns NULL if the checkpoint can not
+ * be used, leaving cpu untouched.
+ */
+APEX_CPU*
+restore_checkpoint(APEX_CPU* cpu, const char* filename)
+{
+  int fd = open(filename, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to open checkpoint file %s\n", filename);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return NULL;
+  }
+
+  /* Fall back to reading the file when it can not be mapped */
+  long size = st.st_size;
+  int mapped = 1;
+  char* base = size > 0 ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  if (base == MAP_FAILED) {
+    mapped = 0;
+    base = size > 0 ? read_file(fd, size) : NULL;
+  }
+  close(fd);
+  if (!base) {
+    fprintf(stderr, "APEX_Error : Unable to read checkpoint file %s\n", filename);
+    return NULL;
+  }
+
+  CHECKPOINT_HEADER* header = (CHECKPOINT_HEADER*)base;
+  APEX_CPU* restored = NULL;
+  APEX_Instruction* code = NULL;
+  if (is_valid_checkpoint(header, size, filename)) {
+    restored = (APEX_CPU*)(base + header->cpu_offset);
+    code = (APEX_Instruction*)(base + header->code_offset);
+    if (!is_same_program(code, header->code_memory_size, cpu)) {
+      fprintf(stderr, "APEX_Error : Checkpoint %s was taken from a different program\n", filename);
+      restored = NULL;
+    }
+  }
+
+  if (restored && !mapped) {
+    APEX_CPU* copy = malloc(sizeof(*copy));
+    APEX_Instruction* code_copy = malloc(sizeof(*code_copy) * (header->code_memory_size + 1));
+    if (copy && code_copy) {
+      memcpy(copy, restored, sizeof(*copy));
+      memcpy(code_copy, code, sizeof(*code_copy) * header->code_memory_size);
+    }
+    else {
+      fprintf(stderr, "APEX_Error : Unable to allocate restored CPU\n");
+      free(code_copy);
+      free(copy);
+      copy = NULL;
+    }
+    restored = copy;
+    code = code_copy;
+  }
+
+  if (!restored) {
+    if (mapped) {
+      munmap(base, size);
+    }
+    else {
+      free(base);
+    }
+    return NULL;
+  }
+
+  restored->code_memory = code;
+  restored->code_map = NULL;
+  restored->code_map_size = 0;
+  restored->interval.state.memory = &restored->interval.memory;
+
+  init_data_memory(&restored->memory);
+  const int* record = (const int*)(base + header->pages_offset);
+  for (int i = 0; i < header->pages_number; i++, record += PAGE_WORDS + 1) {
+    if (record[0] < 0 || record[0] >= PAGE_DIRECTORY_SIZE * PAGE_TABLE_SIZE) {
+      continue;
+    }
+    write_memory_block(&restored->memory, record[0] * PAGE_WORDS, record + 1, PAGE_WORDS);
+  }
+
+  restored->max_cycles = cpu->max_cycles;
+  restored->loop.enabled = cpu->loop.enabled;
+  restored->scheduler.enabled = cpu->scheduler.enabled;
+  init_delta_dump(restored);
+  restored->delta.enabled = cpu->delta.enabled;
+  restored->stalls.interval = cpu->stalls.interval;
+  restored->occupancy.histograms = cpu->occupancy.histograms;
+  restored->latency.histograms = cpu->latency.histograms;
+  restored->checkpoint = cpu->checkpoint;
+
+  /* Streams are the ones opened for this run, the input continues where the saved run stopped */
+  long input_position = restored->devices.input_position;
+  restored->devices = cpu->devices;
+  restored->devices.input_position = input_position;
+  memset(&cpu->devices, 0, sizeof(cpu->devices));
+
+  /* Commit trace of this run starts with the first restored commit */
+  restored->trace = cpu->trace;
+  memset(&cpu->trace, 0, sizeof(cpu->trace));
+
+  /* So is the pipeline view, fetch order goes on from the saved run */
+  long sequence = restored->pipeview.sequence;
+  restored->pipeview = cpu->pipeview;
+  restored->pipeview.sequence = sequence;
+  memset(&cpu->pipeview, 0, sizeof(cpu->pipeview));
+  restored->chrome = cpu->chrome;
+  memset(&cpu->chrome, 0, sizeof(cpu->chrome));
+  restored->series = cpu->series;
+  memset(&cpu->series, 0, sizeof(cpu->series));
+  restored->live = cpu->live;
+  memset(&cpu->live, 0, sizeof(cpu->live));
+  restored->log = cpu->log;
+  cpu->log = NULL;
+  restored->code_lines = cpu->code_lines;
+  cpu->code_lines = NULL;
+  restored->profile = cpu->profile;
+  cpu->profile = NULL;
+  /* The saved stack is looked up again in the call graph of this run */
+  restored->call_graph = cpu->call_graph;
+  cpu->call_graph = NULL;
+  restored->call_stack.node = -1;
+  restored->checkpoint.next_clock = restored->clock + restored->checkpoint.interval;
+  if (mapped) {
+    restored->checkpoint.map = base;
+    restored->checkpoint.map_size = size;
+  }
+  else {
+    free(base);
+  }
+
+  /* Events of the saved run may not cover a change of the scheduler mode,
+   * so every component is evaluated once in the first restored cycle
+   */
+  for (enum COMPONENTS component = 0; component < NUM_COMPONENTS; component++) {
+    schedule_event(restored, component, 0);
+  }
+
+  APEX_cpu_stop(cpu);
+  return restored;
+}
+
+/* Unmaps the checkpoint a CPU was restored from, together with the CPU itself */
+void
+release_checkpoint(APEX_CPU* cpu)
+{
+  void* map = cpu->checkpoint.map;
+  long size = cpu->checkpoint.map_size;
+  munmap(map, size);
+}
@@ -0,0 +1,19 @@
+/*
+ *  checkpoint_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+int
+save_checkpoint(APEX_CPU* cpu, const char* filename);
+
+void
+periodic_checkpoint(APEX_CPU* cpu);
+
+APEX_CPU*
+restore_checkpoint(APEX_CPU* cpu, const char* filename);
+
+void
+release_checkpoint(APEX_CPU* cpu);
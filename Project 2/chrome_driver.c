@@ -0,0 +1,166 @@
+/*
+ *  chrome_driver.c
+ *  Pipeline activity in the Chrome trace-event JSON format
+ *
+ *  The file opens in chrome://tracing and Perfetto. Int_FU, Mul_FU, MEM and
+ *  the two commit slots are threads of one process; every instruction in
+ *  them is a complete ("X") event named by its opcode, with its PC and ROB
+ *  entry as arguments. The used entries of the IQ, ROB and LSQ are one
+ *  counter ("C") event, written only when a size changes. One cycle is one
+ *  microsecond of trace time.
+ *
+ *  Events are written as they happen through a large stdio buffer, so
+ *  memory stays bounded however long the run is. An FU event is written when
+ *  the instruction enters the unit, with the latency of the unit, even if a
+ *  flush cuts it short. Iterations skipped by the loop fast-forward have no
+ *  events.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "chrome_driver.h"
+
+#define CHROME_BUFFER_SIZE (1 << 20)
+#define CHROME_COMMIT_TID NUM_STAGES    // commit slots follow the stages
+
+static void
+write_event(CHROME_TRACE* trace, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void
+write_event(CHROME_TRACE* trace, const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int length = vfprintf(trace->file, format, args);
+  va_end(args);
+  if (length < 0) {
+    fprintf(stderr, "APEX_Error : Unable to write Chrome trace\n");
+    exit(1);
+  }
+  trace->bytes += length;
+  trace->events++;
+}
+
+int
+open_chrome_trace(CHROME_TRACE* trace, const char* filename)
+{
+  trace->file = fopen(filename, "w+");
+  if (!trace->file) {
+    fprintf(stderr, "APEX_Error : Unable to open Chrome trace %s\n", filename);
+    return -1;
+  }
+  setvbuf(trace->file, NULL, _IOFBF, CHROME_BUFFER_SIZE);
+  trace->bytes = 0;
+  trace->events = 0;
+  memset(trace->queue_sizes, -1, sizeof(trace->queue_sizes));
+
+  /* Names of the tracks, later events are written with a leading comma */
+  static const char* fu_names[] = {"Int_FU", "Mul_FU", "MEM"};
+  static const int fu_ids[] = {Int_FU, Mul_FU, MEM};
+  write_event(trace, "{\"traceEvents\":[\n"
+              "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"APEX\"}}");
+  for (int i = 0; i < 3 + COMMIT_WIDTH; i++) {
+    char name[32];
+    int tid = i < 3 ? fu_ids[i] : CHROME_COMMIT_TID + i - 3;
+    if (i < 3) {
+      snprintf(name, sizeof(name), "%s", fu_names[i]);
+    }
+    else {
+      snprintf(name, sizeof(name), "Commit %d", i - 3);
+    }
+    write_event(trace, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                tid, name);
+    write_event(trace, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+                tid, i);
+  }
+  return 0;
+}
+
+void
+close_chrome_trace(CHROME_TRACE* trace)
+{
+  if (trace->file) {
+    fprintf(trace->file, "\n]}\n");
+    fclose(trace->file);
+  }
+  trace->file = NULL;
+}
+
+/* Drops events written after the trace was restored to an earlier point */
+void
+rewind_chrome_trace(CHROME_TRACE* trace)
+{
+  if (!trace->file) {
+    return;
+  }
+  fflush(trace->file);
+  if (ftruncate(fileno(trace->file), trace->bytes) != 0 ||
+      fseek(trace->file, trace->bytes, SEEK_SET) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to rewind Chrome trace\n");
+  }
+}
+
+/* The instruction in the FU stage keeps the unit busy for the given cycles from now */
+void
+trace_fu_busy(APEX_CPU* cpu, enum STAGES FU_type, int cycles)
+{
+  CPU_Stage* stage = &cpu->stage[FU_type];
+  write_event(&cpu->chrome,
+              ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%d,\"dur\":%d,\"pid\":1,\"tid\":%d,"
+              "\"args\":{\"pc\":%d,\"rob\":%d}}",
+              stage->opcode, cpu->clock, cycles, FU_type, stage->pc, stage->rob_entry_id);
+}
+
+/* Called as the instruction leaves the ROB, in the slot of the commits done this cycle */
+void
+trace_commit(APEX_CPU* cpu, ROB_Entry* entry)
+{
+  int slot = cpu->commitments < COMMIT_WIDTH ? cpu->commitments : COMMIT_WIDTH - 1;
+  write_event(&cpu->chrome,
+              ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%d,\"dur\":1,\"pid\":1,\"tid\":%d,"
+              "\"args\":{\"pc\":%d,\"rob\":%d}}",
+              entry->opcode, cpu->clock, CHROME_COMMIT_TID + slot, entry->pc,
+              (int)(entry - cpu->rob.rob_entry));
+}
+
+/* Called at the end of every simulated cycle */
+void
+trace_queue_sizes(APEX_CPU* cpu)
+{
+  int sizes[NUM_OCC_QUEUES] = {0};
+  for (int i = 0; i < IQ_ENTRIES_NUMBER; i++) {
+    sizes[OCC_IQ] += !cpu->iq.iq_entry[i].free;
+  }
+  for (int i = 0; i < ROB_ENTRIES_NUMBER; i++) {
+    sizes[OCC_ROB] += !cpu->rob.rob_entry[i].free;
+  }
+  for (int i = 0; i < LSQ_ENTRIES_NUMBER; i++) {
+    sizes[OCC_LSQ] += !cpu->lsq.lsq_entry[i].free;
+  }
+  if (memcmp(sizes, cpu->chrome.queue_sizes, sizeof(sizes)) == 0) {
+    return;
+  }
+  memcpy(cpu->chrome.queue_sizes, sizes, sizeof(sizes));
+  write_event(&cpu->chrome,
+              ",\n{\"name\":\"Queues\",\"ph\":\"C\",\"ts\":%d,\"pid\":1,"
+              "\"args\":{\"IQ\":%d,\"ROB\":%d,\"LSQ\":%d}}",
+              cpu->clock, sizes[OCC_IQ], sizes[OCC_ROB], sizes[OCC_LSQ]);
+}
+
+void
+display_chrome_trace_stats(APEX_CPU* cpu)
+{
+  printf("\n================================= CHROME TRACE =================================\n");
+  printf("         |\tEvents written\t\t|\t%ld\t|\n", cpu->chrome.events);
+  printf("         |\tBytes written\t\t|\t%ld\t|\n", cpu->chrome.bytes);
+  printf("================================================================================\n");
+}
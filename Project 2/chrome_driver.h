@@ -0,0 +1,28 @@
+/*
+ *  chrome_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+int
+open_chrome_trace(CHROME_TRACE* trace, const char* filename);
+
+void
+close_chrome_trace(CHROME_TRACE* trace);
+
+void
+rewind_chrome_trace(CHROME_TRACE* trace);
+
+void
+trace_fu_busy(APEX_CPU* cpu, enum STAGES FU_type, int cycles);
+
+void
+trace_commit(APEX_CPU* cpu, ROB_Entry* entry);
+
+void
+trace_queue_sizes(APEX_CPU* cpu);
+
+void
+display_chrome_trace_stats(APEX_CPU* cpu);
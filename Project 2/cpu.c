@@ -16,6 +16,25 @@
 #include "rob_driver.h"
 #include "branch_driver.h"
 #include "lsq_driver.h"
+#include "loop_driver.h"
+#include "scheduler_driver.h"
+#include "checkpoint_driver.h"
+#include "object_driver.h"
+#include "memory_driver.h"
+#include "device_driver.h"
+#include "trace_driver.h"
+#include "log_driver.h"
+#include "delta_driver.h"
+#include "stall_driver.h"
+#include "occupancy_driver.h"
+#include "latency_driver.h"
+#include "topdown_driver.h"
+#include "profile_driver.h"
+#include "callstack_driver.h"
+#include "pipeview_driver.h"
+#include "chrome_driver.h"
+#include "series_driver.h"
+#include "live_driver.h"
 
 /* Flag to enable debug messages */
 int ENABLE_DEBUG_MESSAGES;
@@ -34,8 +53,14 @@ APEX_cpu_init(const char* filename, const char* function, const int cycles)
   if (!cpu) {
     return NULL;
   }
-
-  if (strcmp(function, "simulate") == 0) {
+  cpu->log = NULL;
+  cpu->profile = NULL;
+  cpu->call_graph = NULL;
+
+  if (strcmp(function, "simulate") == 0 ||
+      strcmp(function, "interval") == 0 ||
+      strcmp(function, "validate") == 0 ||
+      strcmp(function, "replay") == 0) {
     ENABLE_DEBUG_MESSAGES = 0;
   }
   else {
@@ -156,10 +181,26 @@ APEX_cpu_init(const char* filename, const char* function, const int cycles)
   //memset(cpu->rat, 0, sizeof(int) * 5);
   //memset(cpu->rrat, 0, sizeof(int) * 5);
   //memset(cpu->stage, 0, sizeof(CPU_Stage) * NUM_STAGES);
-  memset(cpu->data_memory, 0, sizeof(int) * 4000);
-
-  /* Parse input file and create code memory */
-  cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
+  init_data_memory(&cpu->memory);
+  memset(&cpu->devices, 0, sizeof(cpu->devices));
+  memset(&cpu->trace, 0, sizeof(cpu->trace));
+  memset(&cpu->pipeview, 0, sizeof(cpu->pipeview));
+  memset(&cpu->chrome, 0, sizeof(cpu->chrome));
+  memset(&cpu->series, 0, sizeof(cpu->series));
+  memset(&cpu->live, 0, sizeof(cpu->live));
+
+  /* Parse input file and create code memory, assembled programs are mapped */
+  cpu->code_memory = NULL;
+  cpu->code_map = NULL;
+  cpu->code_map_size = 0;
+  cpu->code_lines = NULL;
+  if (is_object_file(filename)) {
+    cpu->code_memory = load_object_file(cpu, filename);
+  }
+  else {
+    DATA_SEGMENT data = { 0, 0, &cpu->memory };
+    cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size, &data, &cpu->code_lines);
+  }
 
   cpu->clock = 1;
   cpu->fill_in_rob = 1;
@@ -168,6 +209,7 @@ APEX_cpu_init(const char* filename, const char* function, const int cycles)
   cpu->commitments = 0;
 
   if (!cpu->code_memory) {
+    free_data_memory(&cpu->memory);
     free(cpu);
     return NULL;
   }
@@ -181,7 +223,7 @@ APEX_cpu_init(const char* filename, const char* function, const int cycles)
 
     for (int i = 0; i < cpu->code_memory_size; ++i) {
       printf("%-9s %-9d %-9d %-9d %-9d\n",
-             cpu->code_memory[i].opcode,
+             get_opcode_name(cpu->code_memory[i].opcode_id),
              cpu->code_memory[i].rd,
              cpu->code_memory[i].rs1,
              cpu->code_memory[i].rs2,
@@ -194,12 +236,23 @@ APEX_cpu_init(const char* filename, const char* function, const int cycles)
     cpu->stage[i].busy = 1;
   }
 
-  cpu->code_memory_size = cycles;
+  cpu->max_cycles = cycles;
+  cpu->instructions_committed = 0;
+  cpu->flushes = 0;
   cpu->mul_cycle = 1;
   cpu->mem_cycle = 1;
   cpu->last_branch_id = -1;
   cpu->last_arith_phys_rd = -1;
 
+  init_loop_detector(cpu);
+  init_scheduler(cpu, !ENABLE_DEBUG_MESSAGES);
+  init_delta_dump(cpu);
+  init_dispatch_stalls(cpu);
+  init_occupancy(cpu);
+  init_latency(cpu);
+  init_top_down(cpu);
+  memset(&cpu->checkpoint, 0, sizeof(cpu->checkpoint));
+
   return cpu;
 }
 
@@ -209,7 +262,29 @@ APEX_cpu_init(const char* filename, const char* function, const int cycles)
 void
 APEX_cpu_stop(APEX_CPU* cpu)
 {
-  free(cpu->code_memory);
+  free_data_memory(&cpu->memory);
+  close_devices(&cpu->devices);
+  close_commit_trace(&cpu->trace);
+  close_pipeview(&cpu->pipeview);
+  close_chrome_trace(&cpu->chrome);
+  close_time_series(&cpu->series);
+  close_live_stats(cpu);
+  free_trace_log(cpu);
+  free_profile(cpu);
+  free_call_stacks(cpu);
+  free(cpu->code_lines);
+
+  /* A CPU restored from a checkpoint lives in the mapping together with its code memory */
+  if (cpu->checkpoint.map) {
+    release_checkpoint(cpu);
+    return;
+  }
+  if (cpu->code_map) {
+    unload_object_file(cpu);
+  }
+  else {
+    free(cpu->code_memory);
+  }
   free(cpu);
 }
 
@@ -320,6 +395,35 @@ print_instruction(int fetch_decode, CPU_Stage* stage)
   }
 }
 
+static const char* opcode_names[NUM_OPCODES] = {
+  "MOVC", "ADD", "SUB", "AND", "OR", "EX-OR", "MUL", "ADDL", "SUBL",
+  "LOAD", "STORE", "BZ", "BNZ", "JUMP", "JAL", "HALT", "UNKNOWN"
+};
+
+/* Maps opcode string into enum OPCODES
+ */
+int
+get_opcode_id(const char* opcode)
+{
+  for (int i = 0; i < OP_UNKNOWN; i++) {
+    if (strcmp(opcode, opcode_names[i]) == 0) {
+      return i;
+    }
+  }
+  return OP_UNKNOWN;
+}
+
+/* Maps enum OPCODES into opcode string
+ */
+const char*
+get_opcode_name(int opcode_id)
+{
+  if (opcode_id < 0 || opcode_id >= NUM_OPCODES) {
+    return opcode_names[OP_UNKNOWN];
+  }
+  return opcode_names[opcode_id];
+}
+
 /* Debug function which dumps the cpu stage
  * content
  */
@@ -354,14 +458,14 @@ print_stage_content(char* name, APEX_CPU* cpu, enum STAGES FU_type)
 }
 
 /* Exception handler messages
- * Key 0 - Computed effective memory is NOT in the range 0 - 4096
+ * Key 0 - Computed effective memory is negative
  * Key 1 - Invalid register input
  */
 int
 exception_handler(int code, char* opcode)
 {
   switch(code) {
-    case 0: printf("ERROR >> Computed effective memory address for %s is out of 4096 memory range size\n", opcode);
+    case 0: printf("ERROR >> Computed effective memory address for %s is out of memory range\n", opcode);
             exit(1);
             break;
 
@@ -390,67 +494,61 @@ clear_stage(APEX_CPU* cpu, enum STAGES FU_type)
 void
 control_flow(APEX_CPU* cpu)
 {
+  cpu->flushes++;
+  note_top_down_flush(cpu);
   flush_instructions(cpu);
   recover_urf_rat(cpu);
   cpu->stage[F].busy = 0;
   cpu->stage[DRF].stalled = 0;
+  note_dispatch_stall(cpu, 0);
+  if (cpu->profile) {
+    profile_flush(cpu, cpu->stage[Int_FU].pc);
+  }
   cpu->pc = cpu->stage[Int_FU].target_address;
   cpu->fill_in_rob = 0;
+  TRACE(cpu, TRACE_EXECUTE, 1, "pc(%d) %s redirects fetch to %d",
+        cpu->stage[Int_FU].pc, cpu->stage[Int_FU].opcode, cpu->pc);
+  note_branch_target(cpu, cpu->stage[Int_FU].pc, cpu->pc);
+
+  /* Flush releases entries and FUs, and restarts fetch */
+  schedule_event(cpu, EV_ISSUE, 0);
+  schedule_event(cpu, EV_LSQ, 0);
+  schedule_event(cpu, EV_DECODE, 0);
+  schedule_event(cpu, EV_FETCH, 0);
 }
 
+/*
+ * Returns 1 if the instruction in decode gets every resource it needs.
+ * The lacking ones are reported to the stall accounting.
+ */
 int
 allowed_dispatch(APEX_CPU* cpu, int dest, int lsq, int branch, int iq)
 {
-  int free_rob_entry = is_rob_entry_free(cpu);
-
-  // ADD, SUB, MUL, AND, OR, EX-OR, MOVC, ADDL, SUBL
-  if (iq && dest && !lsq && !branch) {
-    if (free_rob_entry && is_iq_entry_free(cpu) && is_phys_reg_free(cpu)) {
-      return 1;
-    }
+  int lacking = 0;
+  if (!is_rob_entry_free(cpu)) {
+    lacking |= 1 << STALL_ROB;
   }
-
-  // BZ, BNZ, JUMP
-  if (iq && !dest && !lsq && branch) {
-    if (free_rob_entry && is_iq_entry_free(cpu) && is_bis_entry_free(cpu)) {
-      return 1;
-    }
+  if (iq && !is_iq_entry_free(cpu)) {
+    lacking |= 1 << STALL_IQ;
   }
-
-  // JAL
-  if (iq && dest && !lsq && branch) {
-    if (free_rob_entry && is_iq_entry_free(cpu) && is_phys_reg_free(cpu) && is_bis_entry_free(cpu)) {
-      return 1;
-    }
-  }
-
-  // LOAD
-  if (iq && dest && lsq && !branch) {
-    if (free_rob_entry && is_iq_entry_free(cpu) && is_phys_reg_free(cpu) && is_lsq_entry_free(cpu)) {
-      return 1;
-    }
+  if (dest && !is_phys_reg_free(cpu)) {
+    lacking |= 1 << STALL_URF;
   }
-
-  // STORE
-  if (iq && !dest && lsq && !branch) {
-    if (free_rob_entry && is_iq_entry_free(cpu) && is_lsq_entry_free(cpu)) {
-      return 1;
-    }
+  if (lsq && !is_lsq_entry_free(cpu)) {
+    lacking |= 1 << STALL_LSQ;
   }
-
-  // HALT
-  if (free_rob_entry && !iq && !dest && !lsq && !branch) {
-    return 1;
+  if (branch && !is_bis_entry_free(cpu)) {
+    lacking |= 1 << STALL_BIS;
   }
-
-  return 0;
+  note_dispatch_stall(cpu, lacking);
+  return !lacking;
 }
 
 int
 dispatch_instruction(APEX_CPU* cpu, int dest, int src1, int src2, int lsq, int branch, enum STAGES FU_type)
 {
   CPU_Stage* stage = &cpu->stage[DRF];
-  //printf("*** %d %s to IQ\n", stage->pc, stage->opcode);
+  TRACE(cpu, TRACE_DECODE, 1, "pc(%d) %s dispatched", stage->pc, stage->opcode);
 
   if (src1) {
     rename_source1(cpu);
@@ -482,68 +580,71 @@ dispatch_instruction(APEX_CPU* cpu, int dest, int src1, int src2, int lsq, int b
   }
 
   // Pushing ROB Entry
-  ROB_Entry* new_rob_entry = malloc(sizeof(*new_rob_entry));
-  new_rob_entry->free = 0;
-  strcpy(new_rob_entry->opcode, stage->opcode);
-  new_rob_entry->pc = stage->pc;
-  new_rob_entry->arch_rd = stage->arch_rd;
-  new_rob_entry->phys_rd = stage->phys_rd;
-  new_rob_entry->arch_rs1 = stage->arch_rs1;
-  new_rob_entry->phys_rs1 = stage->phys_rs1;
-  new_rob_entry->arch_rs2 = stage->arch_rs2;
-  new_rob_entry->phys_rs2 = stage->phys_rs2;
-  new_rob_entry->imm = stage->imm;
-  if (strcmp(stage->opcode, "HALT") == 0) { new_rob_entry->status = 1; }
-  else { new_rob_entry->status = 0; }
-  new_rob_entry->branch_id = cpu->last_branch_id;
-  stage->rob_entry_id = push_rob_entry(cpu, new_rob_entry);
+  ROB_Entry new_rob_entry;
+  new_rob_entry.free = 0;
+  strcpy(new_rob_entry.opcode, stage->opcode);
+  new_rob_entry.pc = stage->pc;
+  new_rob_entry.arch_rd = stage->arch_rd;
+  new_rob_entry.phys_rd = stage->phys_rd;
+  new_rob_entry.arch_rs1 = stage->arch_rs1;
+  new_rob_entry.phys_rs1 = stage->phys_rs1;
+  new_rob_entry.arch_rs2 = stage->arch_rs2;
+  new_rob_entry.phys_rs2 = stage->phys_rs2;
+  new_rob_entry.imm = stage->imm;
+  new_rob_entry.fetch_clock = stage->fetch_clock;
+  new_rob_entry.decode_clock = stage->decode_clock;
+  new_rob_entry.sequence = stage->sequence;
+  if (strcmp(stage->opcode, "HALT") == 0) { new_rob_entry.status = 1; }
+  else { new_rob_entry.status = 0; }
+  new_rob_entry.branch_id = cpu->last_branch_id;
+  stage->rob_entry_id = push_rob_entry(cpu, &new_rob_entry);
 
   if (lsq) {
-    LSQ_Entry* new_lsq_entry = malloc(sizeof(*new_lsq_entry));
-    new_lsq_entry->free = 0;
-    strcpy(new_lsq_entry->opcode, stage->opcode);
-    new_lsq_entry->pc = stage->pc;
-    new_lsq_entry->mem_address_valid = 0;
-    new_lsq_entry->mem_address = 0;
-    new_lsq_entry->branch_id = cpu->last_branch_id;
-    new_lsq_entry->rob_entry_id = stage->rob_entry_id;
-    new_lsq_entry->rs1_ready = stage->rs1_valid;
-    new_lsq_entry->phys_rs1 = stage->phys_rs1;
-    new_lsq_entry->arch_rs1 = stage->arch_rs1;
-    new_lsq_entry->rs1_value = stage->rs1_value;
-    new_lsq_entry->phys_rs2 = stage->phys_rs2;
-    new_lsq_entry->arch_rs2 = stage->arch_rs2;
-    new_lsq_entry->imm = stage->imm;
-    new_lsq_entry->arch_rd = stage->arch_rd;
-    new_lsq_entry->phys_rd = stage->phys_rd;
-    stage->LSQ_index = push_lsq_entry(cpu, new_lsq_entry);
+    LSQ_Entry new_lsq_entry;
+    new_lsq_entry.free = 0;
+    strcpy(new_lsq_entry.opcode, stage->opcode);
+    new_lsq_entry.pc = stage->pc;
+    new_lsq_entry.mem_address_valid = 0;
+    new_lsq_entry.mem_address = 0;
+    new_lsq_entry.branch_id = cpu->last_branch_id;
+    new_lsq_entry.rob_entry_id = stage->rob_entry_id;
+    new_lsq_entry.rs1_ready = stage->rs1_valid;
+    new_lsq_entry.phys_rs1 = stage->phys_rs1;
+    new_lsq_entry.arch_rs1 = stage->arch_rs1;
+    new_lsq_entry.rs1_value = stage->rs1_value;
+    new_lsq_entry.phys_rs2 = stage->phys_rs2;
+    new_lsq_entry.arch_rs2 = stage->arch_rs2;
+    new_lsq_entry.imm = stage->imm;
+    new_lsq_entry.arch_rd = stage->arch_rd;
+    new_lsq_entry.phys_rd = stage->phys_rd;
+    stage->LSQ_index = push_lsq_entry(cpu, &new_lsq_entry);
   }
 
   // Pushing IQ Entry
   if (strcmp(stage->opcode, "HALT") != 0) {
-    ISSUE_QUEUE_Entry* new_iq_entry = malloc(sizeof(*new_iq_entry));
-    new_iq_entry->pc = stage->pc;
-    strcpy(new_iq_entry->opcode, stage->opcode);
-    new_iq_entry->counter = 1;
-    new_iq_entry->free = 0;
-    new_iq_entry->FU_type = FU_type;
-    new_iq_entry->imm = stage->imm;
-    new_iq_entry->arch_rs1 = stage->arch_rs1;
-    if (!src1) { new_iq_entry->rs1_ready = 1; }
-    else { new_iq_entry->rs1_ready = stage->rs1_valid; }
-    new_iq_entry->phys_rs1 = stage->phys_rs1;
-    new_iq_entry->rs1_value = stage->rs1_value;
-    new_iq_entry->arch_rs2 = stage->arch_rs2;
-    if (!src2) { new_iq_entry->rs2_ready = 1; }
-    else { new_iq_entry->rs2_ready = stage->rs2_valid; }
-    new_iq_entry->phys_rs2 = stage->phys_rs2;
-    new_iq_entry->rs2_value = stage->rs2_value;
-    new_iq_entry->arch_rd = stage->arch_rd;
-    new_iq_entry->phys_rd = stage->phys_rd;
-    new_iq_entry->LSQ_index = stage->LSQ_index;
-    new_iq_entry->branch_id = cpu->last_branch_id;
-    new_iq_entry->rob_entry_id = stage->rob_entry_id;
-    push_iq_entry(cpu, new_iq_entry);
+    ISSUE_QUEUE_Entry new_iq_entry;
+    new_iq_entry.pc = stage->pc;
+    strcpy(new_iq_entry.opcode, stage->opcode);
+    new_iq_entry.counter = 1;
+    new_iq_entry.free = 0;
+    new_iq_entry.FU_type = FU_type;
+    new_iq_entry.imm = stage->imm;
+    new_iq_entry.arch_rs1 = stage->arch_rs1;
+    if (!src1) { new_iq_entry.rs1_ready = 1; }
+    else { new_iq_entry.rs1_ready = stage->rs1_valid; }
+    new_iq_entry.phys_rs1 = stage->phys_rs1;
+    new_iq_entry.rs1_value = stage->rs1_value;
+    new_iq_entry.arch_rs2 = stage->arch_rs2;
+    if (!src2) { new_iq_entry.rs2_ready = 1; }
+    else { new_iq_entry.rs2_ready = stage->rs2_valid; }
+    new_iq_entry.phys_rs2 = stage->phys_rs2;
+    new_iq_entry.rs2_value = stage->rs2_value;
+    new_iq_entry.arch_rd = stage->arch_rd;
+    new_iq_entry.phys_rd = stage->phys_rd;
+    new_iq_entry.LSQ_index = stage->LSQ_index;
+    new_iq_entry.branch_id = cpu->last_branch_id;
+    new_iq_entry.rob_entry_id = stage->rob_entry_id;
+    push_iq_entry(cpu, &new_iq_entry);
   }
 
   return 0;
@@ -555,9 +656,35 @@ fetch(APEX_CPU* cpu)
   CPU_Stage* stage = &cpu->stage[F];
   if (!stage->busy && !stage->stalled) {
 
-    APEX_Instruction* current_ins = &cpu->code_memory[get_code_index(cpu->pc)];
+    if (cpu->loop.enabled && cpu->pc == cpu->loop.head_pc && loop_head_reached(cpu)) {
+      /* Hold fetch while the pipeline drains, empty ROB must not finish the simulation */
+      clear_stage(cpu, F);
+      if (!cpu->stage[DRF].stalled) {
+        cpu->stage[DRF] = cpu->stage[F];
+      }
+      cpu->fill_in_rob = 0;
+
+      if (ENABLE_DEBUG_MESSAGES) {
+        print_stage_content("Fetch", cpu, F);
+      }
+      schedule_event(cpu, EV_FETCH, 1);
+      return 0;
+    }
+
+    /* Wrong path may run past the end of the program, nothing is fetched there */
+    static const APEX_Instruction no_instruction = { OP_UNKNOWN, 0, 0, 0, 0 };
+    const APEX_Instruction* current_ins = &no_instruction;
+    int index = get_code_index(cpu->pc);
+    if (index >= 0 && index < cpu->code_memory_size) {
+      current_ins = &cpu->code_memory[index];
+      strcpy(stage->opcode, get_opcode_name(current_ins->opcode_id));
+    }
+    else {
+      strcpy(stage->opcode, "");
+    }
     stage->pc = cpu->pc;
-    strcpy(stage->opcode, current_ins->opcode);
+    stage->fetch_clock = cpu->clock;
+    stage->sequence = cpu->pipeview.sequence++;
     stage->arch_rs1 = current_ins->rs1;
     stage->arch_rs2 = current_ins->rs2;
     stage->arch_rd = current_ins->rd;
@@ -586,12 +713,14 @@ fetch(APEX_CPU* cpu)
     /* Copy data from fetch latch to decode latch */
     if (!cpu->stage[DRF].stalled) {
       cpu->stage[DRF] = cpu->stage[F];
+      cpu->stage[DRF].decode_clock = cpu->clock + 1;
+      schedule_event(cpu, EV_DECODE, 1);
     }
     else {
       stage->stalled = 1;
     }
 
-    //printf("*** Fetch: stalled=%d, busy=%d\n", stage->stalled, stage->busy);
+    TRACE(cpu, TRACE_FETCH, 2, "fetch pc(%d) stalled=%d busy=%d", stage->pc, stage->stalled, stage->busy);
   }
   else {
 
@@ -602,12 +731,19 @@ fetch(APEX_CPU* cpu)
     if (!cpu->stage[DRF].stalled) {
       stage->stalled = 0;
       cpu->stage[DRF] = cpu->stage[F];
+      cpu->stage[DRF].decode_clock = cpu->clock + 1;
+      schedule_event(cpu, EV_DECODE, 1);
     }
 
     if (ENABLE_DEBUG_MESSAGES) {
       print_stage_content("Fetch", cpu, F);
     }
-    //printf("*** Fetch: stalled=%d, busy=%d\n", stage->stalled, stage->busy);
+    TRACE(cpu, TRACE_FETCH, 2, "fetch pc(%d) stalled=%d busy=%d", stage->pc, stage->stalled, stage->busy);
+  }
+
+  /* Fetch sleeps after HALT until a branch redirects it */
+  if (!stage->busy) {
+    schedule_event(cpu, EV_FETCH, 1);
   }
   return 0;
 }
@@ -721,7 +857,7 @@ decode(APEX_CPU* cpu)
         clear_stage(cpu, DRF);
       }
     }
-    //printf("*** Decode: stalled=%d, busy=%d\n", stage->stalled, stage->busy);
+    TRACE(cpu, TRACE_DECODE, 2, "decode pc(%d) stalled=%d busy=%d", stage->pc, stage->stalled, stage->busy);
   }
   else {
     if (stage->stalled) {
@@ -813,7 +949,7 @@ decode(APEX_CPU* cpu)
         clear_stage(cpu, DRF);
       }
     }
-    //printf("*** Decode: stalled=%d, busy=%d\n", stage->stalled, stage->busy);
+    TRACE(cpu, TRACE_DECODE, 2, "decode pc(%d) stalled=%d busy=%d", stage->pc, stage->stalled, stage->busy);
   }
   return 0;
 }
@@ -829,6 +965,9 @@ execute_int(APEX_CPU* cpu)
 {
   CPU_Stage* stage = &cpu->stage[Int_FU];
   if (!stage->busy && !stage->stalled) {
+    if (cpu->chrome.file && strcmp(stage->opcode, "") != 0) {
+      trace_fu_busy(cpu, Int_FU, 1);
+    }
 
     if (strcmp(stage->opcode, "MOVC") == 0) {
       stage->buffer = stage->imm + 0;
@@ -867,6 +1006,7 @@ execute_int(APEX_CPU* cpu)
       int phys_src = cpu->bis.bis_entry[branch_id].phys_src;
       if (cpu->urf[phys_src].value == 0) {
         stage->target_address = stage->pc + stage->imm;
+        cpu->rob.rob_entry[stage->rob_entry_id].taken = 1;
         control_flow(cpu);
       }
     }
@@ -876,36 +1016,40 @@ execute_int(APEX_CPU* cpu)
       int phys_src = cpu->bis.bis_entry[branch_id].phys_src;
       if (cpu->urf[phys_src].value != 0) {
         stage->target_address = stage->pc + stage->imm;
+        cpu->rob.rob_entry[stage->rob_entry_id].taken = 1;
         control_flow(cpu);
       }
     }
 
     if (strcmp(stage->opcode, "JUMP") == 0) {
       stage->target_address = stage->rs1_value + stage->imm;
+      cpu->rob.rob_entry[stage->rob_entry_id].taken = 1;
       control_flow(cpu);
     }
 
     if (strcmp(stage->opcode, "JAL") == 0) {
       stage->target_address = stage->rs1_value + stage->imm;
       stage->buffer = stage->pc + 4;
-      printf("*** stage->target_address = %d\n", stage->target_address);
-      printf("*** stage->buffer = %d\n", stage->buffer);
+      TRACE(cpu, TRACE_EXECUTE, 1, "JAL pc(%d) links %d", stage->pc, stage->buffer);
+      cpu->rob.rob_entry[stage->rob_entry_id].taken = 1;
       control_flow(cpu);
     }
 
     if (strcmp(stage->opcode, "STORE") == 0) {
       stage->buffer = stage->rs2_value + stage->imm;
-      if (stage->buffer > 4096 || stage->buffer < 0) {
+      if (stage->buffer < 0) {
         exception_handler(0, stage->opcode);
       }
+      cpu->rob.rob_entry[stage->rob_entry_id].mem_address = stage->buffer;
       update_lsq_entry(cpu, Int_FU);
     }
 
     if (strcmp(stage->opcode, "LOAD") == 0) {
       stage->buffer = stage->rs1_value + stage->imm;
-      if (stage->buffer > 4096 || stage->buffer < 0) {
+      if (stage->buffer < 0) {
         exception_handler(0, stage->opcode);
       }
+      cpu->rob.rob_entry[stage->rob_entry_id].mem_address = stage->buffer;
       update_lsq_entry(cpu, Int_FU);
     }
 
@@ -951,7 +1095,11 @@ execute_mul(APEX_CPU* cpu)
     if (strcmp(stage->opcode, "MUL") == 0) {
       stage->buffer = stage->rs1_value * stage->rs2_value;
       stage->stalled = 1;
+      if (cpu->chrome.file) {
+        trace_fu_busy(cpu, Mul_FU, MUL_LATENCY);
+      }
       cpu->mul_cycle++;
+      schedule_event(cpu, EV_EXECUTE_MUL, MUL_LATENCY - 1);
     }
 
   }
@@ -966,11 +1114,19 @@ execute_mul(APEX_CPU* cpu)
       update_rob_entry(cpu, Mul_FU);
       clear_stage(cpu, Mul_FU);
       cpu->mul_cycle = 1;
+      schedule_event(cpu, EV_ISSUE, 0);
     }
   }
   return 0;
 }
 
+/*
+ *  Memory Stage of APEX Pipeline
+ *
+ *  LOAD and STORE stay in MEM for MEM_LATENCY cycles. The cycle counter is
+ *  derived from the clock, so the stage does not need to be evaluated in the
+ *  cycles in between.
+ */
 int
 memory(APEX_CPU* cpu)
 {
@@ -981,7 +1137,8 @@ memory(APEX_CPU* cpu)
     }
 
     if (strcmp(stage->opcode, "LOAD") == 0) {
-      stage->buffer = cpu->data_memory[stage->mem_address];
+      stage->buffer = load_word(cpu, stage->mem_address);
+      TRACE(cpu, TRACE_MEMORY, 1, "LOAD pc(%d) read %d from %d", stage->pc, stage->buffer, stage->mem_address);
       cpu->mem_cycle++;
       stage->stalled = 1;
     }
@@ -990,18 +1147,31 @@ memory(APEX_CPU* cpu)
       cpu->mem_cycle++;
       stage->stalled = 1;
     }
+
+    if (stage->stalled) {
+      if (cpu->chrome.file) {
+        trace_fu_busy(cpu, MEM, MEM_LATENCY);
+      }
+      cpu->mem_done_clock = cpu->clock + MEM_LATENCY - 1;
+      schedule_event(cpu, EV_MEMORY, MEM_LATENCY - 1);
+    }
   }
   else {
+    if (stage->stalled) {
+      cpu->mem_cycle = MEM_LATENCY - (cpu->mem_done_clock - cpu->clock);
+    }
+
     if (ENABLE_DEBUG_MESSAGES) {
       print_stage_content("Memory", cpu, MEM);
     }
 
     if (stage->stalled) {
 
-      if (cpu->mem_cycle == 3) {
+      if (cpu->clock == cpu->mem_done_clock) {
 
         if (strcmp(stage->opcode, "STORE") == 0) {
-          cpu->data_memory[stage->mem_address] = stage->rs1_value;
+          store_word(cpu, stage->mem_address, stage->rs1_value);
+          TRACE(cpu, TRACE_MEMORY, 1, "STORE pc(%d) wrote %d to %d", stage->pc, stage->rs1_value, stage->mem_address);
         }
 
         if (strcmp(stage->opcode, "LOAD") == 0) {
@@ -1011,6 +1181,7 @@ memory(APEX_CPU* cpu)
         stage->stalled = 0;
         cpu->mem_cycle = 1;
         clear_stage(cpu, MEM);
+        schedule_event(cpu, EV_LSQ, 0);
         return 0;
       }
       cpu->mem_cycle++;
@@ -1020,43 +1191,131 @@ memory(APEX_CPU* cpu)
   return 0;
 }
 
+/*
+ * Simulates one clock cycle. Cycles without any event that follow it
+ * are skipped as well.
+ */
+void
+APEX_cpu_step(APEX_CPU* cpu)
+{
+  if (ENABLE_DEBUG_MESSAGES) {
+    printf("\n================================ CLOCK CYCLE %d ================================\n\n", cpu->clock);
+  }
+
+  if (has_event(cpu, EV_COMMIT) && commit_rob_entry(cpu)) {
+    commit_rob_entry(cpu);
+  }
+  if (has_event(cpu, EV_MEMORY)) { memory(cpu); }
+  if (has_event(cpu, EV_EXECUTE_INT)) { execute_int(cpu); }
+  if (has_event(cpu, EV_EXECUTE_MUL)) { execute_mul(cpu); }
+  if (ENABLE_DEBUG_MESSAGES) {
+    if (cpu->delta.enabled) { display_iq_delta(cpu); }
+    else { display_iq(cpu); }
+  }
+  if (has_event(cpu, EV_ISSUE)) { process_iq(cpu); }
+  if (ENABLE_DEBUG_MESSAGES) {
+    if (cpu->delta.enabled) {
+      display_rob_delta(cpu);
+      display_lsq_delta(cpu);
+    }
+    else {
+      display_rob(cpu);
+      display_lsq(cpu);
+    }
+  }
+  if (has_event(cpu, EV_LSQ)) { process_lsq(cpu); }
+  if (ENABLE_DEBUG_MESSAGES) {
+    if (cpu->delta.enabled) { display_registers_delta(cpu); }
+    else { display_registers(cpu); }
+  }
+  if (has_event(cpu, EV_DECODE)) { decode(cpu); }
+  if (has_event(cpu, EV_FETCH)) { fetch(cpu); }
+
+  /* Skip cycles in which no component has anything to do */
+  int cycles = advance_scheduler(cpu);
+  if (cycles == -1) {
+    cycles = cpu->max_cycles - cpu->clock + 1;
+  }
+  sample_occupancy(cpu, cycles);
+  account_top_down(cpu, cycles);
+  if (cpu->profile) {
+    profile_cycle(cpu, cycles);
+  }
+  if (cpu->call_graph) {
+    call_stack_cycle(cpu, cycles);
+  }
+  if (cpu->chrome.file) {
+    trace_queue_sizes(cpu);
+  }
+  cpu->clock += cycles;
+  cpu->fill_in_rob += cycles;
+  cpu->commitments = 0;
+  if (cpu->series.file) {
+    sample_time_series(cpu);
+  }
+  if (cpu->live.stats && cpu->clock >= cpu->live.next_clock) {
+    publish_live_stats(cpu);
+  }
+}
+
 int
 APEX_cpu_run(APEX_CPU* cpu)
 {
-  while (cpu->clock <= cpu->code_memory_size) {
+  while (cpu->clock <= cpu->max_cycles) {
     /* All the instructions committed, so exit */
     if (cpu->simulation_completed) {
       printf("\n=============================== SIMULATION FINISHED ============================\n");
       break;
     }
 
-    if (ENABLE_DEBUG_MESSAGES) {
-      printf("\n================================ CLOCK CYCLE %d ================================\n\n", cpu->clock);
-    }
-
-    if (commit_rob_entry(cpu)) {
-      commit_rob_entry(cpu);
-    }
-    memory(cpu);
-    execute_int(cpu);
-    execute_mul(cpu);
-    if (ENABLE_DEBUG_MESSAGES) { display_iq(cpu); }
-    process_iq(cpu);
-    if (ENABLE_DEBUG_MESSAGES) {
-      display_rob(cpu);
-      display_lsq(cpu);
-    }
-    process_lsq(cpu);
-    if (ENABLE_DEBUG_MESSAGES) { display_registers(cpu); }
-    decode(cpu);
-    fetch(cpu);
+    APEX_cpu_step(cpu);
+    periodic_checkpoint(cpu);
+    report_stall_interval(cpu);
+  }
 
-    cpu->clock++;
-    cpu->fill_in_rob++;
-    cpu->commitments = 0;
+  if (cpu->checkpoint.filename) {
+    save_checkpoint(cpu, cpu->checkpoint.filename);
   }
 
+  finish_stall_intervals(cpu);
+  if (cpu->series.file) {
+    finish_time_series(cpu);
+  }
   display_regs_mem(cpu);
+  display_stall_stats(cpu);
+  display_occupancy_stats(cpu);
+  display_latency_stats(cpu);
+  display_top_down_stats(cpu);
+  if (cpu->profile) {
+    display_profile(cpu);
+  }
+  if (cpu->call_graph) {
+    display_call_stacks(cpu);
+  }
+  if (cpu->loop.enabled) {
+    display_loop_stats(cpu);
+  }
+  if (cpu->scheduler.enabled) {
+    display_scheduler_stats(cpu);
+  }
+  if (cpu->devices.input || cpu->devices.output) {
+    display_device_stats(cpu);
+  }
+  if (cpu->trace.writer) {
+    display_trace_stats(cpu);
+  }
+  if (cpu->pipeview.file) {
+    display_pipeview_stats(cpu);
+  }
+  if (cpu->chrome.file) {
+    display_chrome_trace_stats(cpu);
+  }
+  if (cpu->series.file) {
+    display_time_series_stats(cpu);
+  }
+  if (cpu->delta.enabled && ENABLE_DEBUG_MESSAGES) {
+    display_delta_stats(cpu);
+  }
 
   return 0;
 }
@@ -17,6 +17,29 @@
  #define RRAT_ENTRIES_NUMBER 16
  #define BIS_ENTRIES_NUMBER 8
 
+ #define MUL_LATENCY 2
+ #define MEM_LATENCY 3
+
+ #define WHEEL_SIZE 64
+ #define FAR_EVENTS_NUMBER 64
+
+ #define MODEL_ENTRIES_MAX 256
+ #define REPLAY_CONFIGS_NUMBER 16
+
+ #define LOOP_SIGNATURE_SIZE 1024
+ #define LOOP_BODY_SIZE 256
+
+ #define PAGE_WORDS 1024
+ #define PAGE_TABLE_SIZE 1024
+ #define PAGE_DIRECTORY_SIZE 2048
+ #define MEMORY_MAPPINGS_NUMBER 16
+
+ /* Last page of data memory is reserved for devices */
+ #define DEVICE_BASE_ADDRESS 0x7ffffc00
+ #define INPUT_PORT_ADDRESS 0x7ffffc00
+ #define INPUT_STATUS_ADDRESS 0x7ffffc01
+ #define OUTPUT_PORT_ADDRESS 0x7ffffc02
+
 enum STAGES
 {
   F,
@@ -27,10 +50,121 @@ enum STAGES
   NUM_STAGES
 };
 
+/* Pipeline components evaluated by the scheduler, in evaluation order */
+enum COMPONENTS
+{
+  EV_COMMIT,
+  EV_MEMORY,
+  EV_EXECUTE_INT,
+  EV_EXECUTE_MUL,
+  EV_ISSUE,
+  EV_LSQ,
+  EV_DECODE,
+  EV_FETCH,
+  NUM_COMPONENTS
+};
+
+/* Resources whose lack holds an instruction in decode, see stall_driver.c */
+enum STALL_CAUSES
+{
+  STALL_ROB,
+  STALL_IQ,
+  STALL_URF,
+  STALL_LSQ,
+  STALL_BIS,
+  NUM_STALL_CAUSES
+};
+
+#define STALL_MASKS_NUMBER (1 << NUM_STALL_CAUSES)
+
+/* Structures whose occupancy is sampled every cycle, see occupancy_driver.c */
+enum OCCUPANCY_STRUCTURES
+{
+  OCC_IQ,
+  OCC_ROB,
+  OCC_LSQ,
+  OCC_BIS,
+  OCC_URF,
+  NUM_OCC_STRUCTURES
+};
+
+/* Queues whose occupancy is also reported during the run, by the time series, the live stats and the chrome trace */
+#define NUM_OCC_QUEUES 3
+static const int occupancy_queues[NUM_OCC_QUEUES] = {OCC_IQ, OCC_ROB, OCC_LSQ};
+
+#define OCCUPANCY_ENTRIES_MAX 64
+#if IQ_ENTRIES_NUMBER > OCCUPANCY_ENTRIES_MAX || ROB_ENTRIES_NUMBER > OCCUPANCY_ENTRIES_MAX || \
+    LSQ_ENTRIES_NUMBER > OCCUPANCY_ENTRIES_MAX || BIS_ENTRIES_NUMBER > OCCUPANCY_ENTRIES_MAX || \
+    URF_ENTRIES_NUMBER > OCCUPANCY_ENTRIES_MAX
+#error "OCCUPANCY_ENTRIES_MAX is smaller than a sampled structure"
+#endif
+
+/* Categories of commit slots, see topdown_driver.c */
+enum TOP_DOWN_CATEGORIES
+{
+  TD_RETIRING,
+  TD_FRONTEND,
+  TD_BAD_SPECULATION,
+  TD_MEMORY,
+  TD_CORE_MUL,
+  TD_CORE_INT,
+  NUM_TD_CATEGORIES
+};
+
+#define COMMIT_WIDTH 2    // instructions leaving the ROB per cycle
+
+/* Opcode classes and lifecycle spans of the latency histograms, see latency_driver.c */
+enum LATENCY_CLASSES
+{
+  LAT_ALU,
+  LAT_MUL,
+  LAT_LOAD,
+  LAT_STORE,
+  LAT_BRANCH,
+  LAT_OTHER,
+  NUM_LAT_CLASSES
+};
+
+enum LATENCY_SPANS
+{
+  SPAN_FETCH_DISPATCH,
+  SPAN_DISPATCH_ISSUE,
+  SPAN_ISSUE_MEMORY,
+  SPAN_ISSUE_COMPLETE,
+  SPAN_COMPLETE_COMMIT,
+  SPAN_FETCH_COMMIT,
+  NUM_LAT_SPANS
+};
+
+#define LATENCY_BINS 64    // the last bin counts every longer latency
+
+/* Opcode ids, used where comparing opcode strings is too slow */
+enum OPCODES
+{
+  OP_MOVC,
+  OP_ADD,
+  OP_SUB,
+  OP_AND,
+  OP_OR,
+  OP_EXOR,
+  OP_MUL,
+  OP_ADDL,
+  OP_SUBL,
+  OP_LOAD,
+  OP_STORE,
+  OP_BZ,
+  OP_BNZ,
+  OP_JUMP,
+  OP_JAL,
+  OP_HALT,
+  OP_UNKNOWN,
+  NUM_OPCODES
+};
+
 /* Format of an APEX instruction  */
 typedef struct APEX_Instruction
 {
-  char opcode[128];	// Operation Code
+  int opcode_id;	// Operation Code as enum OPCODES
   int rd;		    // Destination Register Address
   int rs1;		    // Source-1 Register Address
   int rs2;		    // Source-2 Register Address
@@ -61,6 +195,9 @@ typedef struct CPU_Stage
   int branch_id;
   int LSQ_index;
   int target_address;
+  int fetch_clock;    // clock in which the instruction was fetched
+  int decode_clock;    // clock in which the instruction reached decode
+  long sequence;    // fetch order, for the pipeline view
 } CPU_Stage;
 
 /* Issue Queue entry */
@@ -90,6 +227,7 @@ typedef struct ISSUE_QUEUE_Entry
   int rob_entry_id;
   int LSQ_index;
   int branch_id;
+  int dispatch_clock;    // clock in which the entry was pushed, counter is derived from it
 } ISSUE_QUEUE_Entry;
 
 /* Issue Queue */
@@ -113,6 +251,17 @@ typedef struct ROB_Entry
   int arch_rs2;
   int phys_rs2;    // source-2 physical address
   int imm;
+  int mem_address;    // effective address of LOAD or STORE, for the commit trace
+  int taken;    // branch redirected the PC, for the commit trace
+
+  /* Lifecycle timestamps, -1 until the event happens, see latency_driver.c */
+  int fetch_clock;
+  int decode_clock;
+  int dispatch_clock;
+  int issue_clock;
+  int memory_clock;
+  int complete_clock;
+  long sequence;    // fetch order, for the pipeline view
 } ROB_Entry;
 
 typedef struct ROB
@@ -192,6 +341,309 @@ typedef struct LSQ
   LSQ_Entry lsq_entry[LSQ_ENTRIES_NUMBER];
 } LSQ;
 
+/* Timing wheel of component wakeups, see scheduler_driver.c */
+typedef struct SCHEDULER
+{
+  int enabled;
+  int now;    // scheduler time, advances with every simulated cycle
+  unsigned int wheel[WHEEL_SIZE];    // bit mask of enum COMPONENTS per cycle
+
+  /* Events too far in the future for the wheel */
+  int far_cycle[FAR_EVENTS_NUMBER];
+  unsigned int far_mask[FAR_EVENTS_NUMBER];
+  int far_count;
+
+  /* Stats */
+  long evaluations;
+  long idle_cycles;
+} SCHEDULER;
+
+/* Image file some pages of data memory are borrowed from */
+typedef struct MEMORY_MAPPING
+{
+  char* base;
+  long size;
+} MEMORY_MAPPING;
+
+/* Sparse data memory of word addresses 0 - 2^31-1, see memory_driver.c */
+typedef struct DATA_MEMORY
+{
+  int** directory[PAGE_DIRECTORY_SIZE];    // page tables, NULL until a page in their range is written
+  int tlb_page;    // page of the last translation, -1 if none
+  int* tlb_words;
+  int pages_number;
+  MEMORY_MAPPING mappings[MEMORY_MAPPINGS_NUMBER];
+  int mappings_number;
+} DATA_MEMORY;
+
+/* Streaming input and output devices, see device_driver.c */
+typedef struct DEVICES
+{
+  const int* input;    // mapping of the input stream file, NULL if none
+  long input_size;    // bytes mapped
+  long input_words;
+  long input_position;    // words popped so far
+  FILE* output;    // output stream file, NULL if none
+  long output_words;    // words pushed so far
+} DEVICES;
+
+/* One committed instruction of the trace */
+typedef struct TRACE_RECORD
+{
+  int pc;
+  int opcode_id;
+  int has_value;    // instruction writes a register
+  int value;    // value written to the destination register
+  int address;    // effective address of LOAD or STORE
+  int taken;    // branch redirected the PC
+} TRACE_RECORD;
+
+/* Reader of a mapped commit trace, records are decoded in place */
+typedef struct TRACE_READER
+{
+  const unsigned char* data;    // first record
+  long size;    // bytes of records
+  long offset;    // next record
+  int last_pc;    // state of the delta encoding
+  int last_address;
+} TRACE_READER;
+
+/* Writer of the committed instruction trace, see trace_driver.c */
+typedef struct COMMIT_TRACE
+{
+  struct TRACE_WRITER* writer;    // NULL when no trace is written
+  long bytes;    // bytes of records written so far
+  long records;
+  int last_pc;    // state of the delta encoding
+  int last_address;
+} COMMIT_TRACE;
+
+/* Commit slots by top-down category */
+typedef struct TOP_DOWN
+{
+  long slots[NUM_TD_CATEGORIES];
+  long loop_mark[NUM_TD_CATEGORIES];    // slots at the last loop head
+  long loop_period[NUM_TD_CATEGORIES];    // slots of the last loop iteration
+  int committed;    // instructions committed when the last cycle was accounted
+  int recovering;    // a flush happened and no younger instruction reached the ROB head yet
+  long recovery_sequence;    // fetch order of the first instruction after the flush
+  long squashed;    // slots of ROB entries removed by flushes, not charged yet
+} TOP_DOWN;
+
+#define CALL_STACK_DEPTH 64
+
+/* Frame of the shadow call stack */
+typedef struct CALL_FRAME
+{
+  int entry;    // PC of the first instruction of the subroutine, -1 until it commits
+  int link;    // architectural register the JAL linked into
+} CALL_FRAME;
+
+/* Shadow call stack of the committed instructions, see callstack_driver.c */
+typedef struct CALL_STACK
+{
+  int depth;    // frames entered and not returned from, may exceed CALL_STACK_DEPTH
+  CALL_FRAME frames[CALL_STACK_DEPTH];
+  int node;    // node of the stack in the call graph, -1 until looked up
+} CALL_STACK;
+
+/* Pipeline view for the Konata and gem5 O3PipeView viewers, see pipeview_driver.c */
+typedef struct PIPE_VIEW
+{
+  FILE* file;    // NULL when no view is written
+  long bytes;    // bytes of records written so far
+  long sequence;    // fetch order of the next fetched instruction
+  long retired;    // records of committed instructions
+  long flushed;    // records of flushed instructions
+} PIPE_VIEW;
+
+/* Chrome trace-event JSON of the FUs, commit and queue sizes, see chrome_driver.c */
+typedef struct CHROME_TRACE
+{
+  FILE* file;    // NULL when no trace is written
+  long bytes;    // bytes of events written so far
+  long events;
+  int queue_sizes[NUM_OCC_QUEUES];    // entries of occupancy_queues used at the last counter event
+} CHROME_TRACE;
+
+/* Stats of fixed intervals of the run, see series_driver.c */
+typedef struct TIME_SERIES
+{
+  FILE* file;    // NULL when no series is written
+  int binary;    // fixed size records instead of CSV lines
+  int interval;    // length of a record, in cycles or committed instructions
+  int by_instructions;    // interval counts committed instructions
+  long bytes;    // bytes written so far
+  long records;
+  long next;    // clock or committed instructions ending the current record
+
+  /* Totals at the start of the current record */
+  int clock;
+  int committed;
+  int flushes;
+  long loads;
+  long stores;
+  long occupancy[NUM_OCC_QUEUES];    // entry cycles of occupancy_queues
+} TIME_SERIES;
+
+/* Counters published in shared memory during the run, see live_driver.c */
+typedef struct LIVE_PAGE
+{
+  struct LIVE_STATS* stats;    // NULL when nothing is published
+  char name[256];    // name of the shared memory object
+  int next_clock;    // clock of the next update
+} LIVE_PAGE;
+
+/* Architectural state for functional execution, see functional_driver.c */
+typedef struct FUNCTIONAL_STATE
+{
+  int regs[RAT_ENTRIES_NUMBER];
+  int flag_value;    // result of the last arithmetic instruction, used by BZ and BNZ
+  int flag_reg;    // architectural register holding flag_value, -1 once overwritten
+  DATA_MEMORY* memory;
+  DEVICES* devices;    // input stream loads read from, NULL to read 0
+  long input_position;    // words of the input stream popped by this state
+
+  /* Side effects of the last executed instruction */
+  int taken;    // PC was redirected
+  int mem_address;    // effective address of LOAD or STORE
+  int mem_old_value;    // value overwritten by STORE
+} FUNCTIONAL_STATE;
+
+/* Structure sizes of the interval model, at most MODEL_ENTRIES_MAX each */
+typedef struct MODEL_CONFIG
+{
+  int rob_entries;
+  int iq_entries;
+  int lsq_entries;
+  int bis_entries;
+} MODEL_CONFIG;
+
+/* Analytical interval model, see interval_driver.c */
+typedef struct INTERVAL_MODEL
+{
+  MODEL_CONFIG config;
+
+  FUNCTIONAL_STATE state;
+  int reg_ready[RAT_ENTRIES_NUMBER];    // cycle in which register value can be picked up by a consumer
+  int flag_ready;
+  DATA_MEMORY memory;
+
+  /* Release times of the last entries of each structure, used as rings */
+  int rob_release[MODEL_ENTRIES_MAX];
+  int iq_release[MODEL_ENTRIES_MAX];
+  int lsq_release[MODEL_ENTRIES_MAX];
+  int bis_release[MODEL_ENTRIES_MAX];
+  int rob_is_load[MODEL_ENTRIES_MAX];
+  int rob_count;
+  int iq_count;
+  int lsq_count;
+  int bis_count;
+
+  int fetch_ready;    // first cycle in which the front end delivers after a redirect
+  int last_dispatch;
+  int last_commit;
+  int commits_in_last_cycle;
+  int int_fu_free;
+  int mul_fu_free;
+  int mem_free;
+
+  /* Results */
+  int instructions;
+  int cycles;
+  int base_cycles;
+  int branch_penalty;
+  int load_penalty;
+  int rob_penalty;
+  int iq_penalty;
+  int lsq_penalty;
+  int bis_penalty;
+  int mispredictions;
+} INTERVAL_MODEL;
+
+/* Steady-state loop detector, see loop_driver.c */
+typedef struct LOOP_DETECTOR
+{
+  int enabled;
+  int head_pc;    // target of the last taken backward branch
+  int signature[LOOP_SIGNATURE_SIZE];    // pipeline state at the last fetch of head_pc
+  int signature_length;
+  int clock;    // clock when signature was taken
+  int instructions;    // committed instructions when signature was taken
+  int period_cycles;    // cycles of one iteration
+  int period_instructions;    // committed instructions of one iteration
+  int flushes;    // flushes when signature was taken
+  int period_flushes;    // flushes of the last iteration
+  int matches;    // consecutive iterations with the same state and period
+  int draining;    // fetch holds at head_pc until the pipeline is empty
+  int drain_start;
+
+  /* Stats */
+  int skips;
+  int iterations_skipped;
+  int cycles_skipped;
+} LOOP_DETECTOR;
+
+/* Checkpointing of the simulator state, see checkpoint_driver.c */
+typedef struct CHECKPOINT
+{
+  const char* filename;    // file checkpoints are saved to, NULL if not saving
+  int interval;    // cycles between periodic checkpoints, 0 to save only at the end of the run
+  int next_clock;    // clock of the next periodic checkpoint
+  void* map;    // mapping of the checkpoint file this CPU was restored from
+  long map_size;
+} CHECKPOINT;
+
+/* Structures as the delta display last printed them, see delta_driver.c */
+typedef struct DELTA_DUMP
+{
+  int enabled;
+  ISSUE_QUEUE iq;
+  ROB rob;
+  LSQ lsq;
+  RENAME_ALIAS_TABLE_Entry rat[RAT_ENTRIES_NUMBER];
+  RETIREMENT_RENAME_ALIAS_TABLE_Entry rrat[RRAT_ENTRIES_NUMBER];
+
+  /* Stats */
+  long rows;    // entries printed
+  long full_rows;    // entries a full display would have printed
+} DELTA_DUMP;
+
+/* Cycles decode could not dispatch, by the set of resources it lacked */
+typedef struct DISPATCH_STALLS
+{
+  int mask;    // resources the instruction in decode waits for, 0 if none
+  int since;    // first cycle of the current mask not counted yet
+  long cycles[STALL_MASKS_NUMBER];    // stalled cycles by mask of STALL_CAUSES
+  long loop_mark[STALL_MASKS_NUMBER];    // cycles at the last loop head
+  long loop_period[STALL_MASKS_NUMBER];    // cycles of the last loop iteration
+  int interval;    // cycles between interval reports, 0 for none
+  int next_report;    // clock of the next interval report
+  long report_mark[STALL_MASKS_NUMBER];    // cycles at the last interval report
+} DISPATCH_STALLS;
+
+/* Cycles spent at each number of used entries, by structure */
+typedef struct OCCUPANCY
+{
+  long cycles[NUM_OCC_STRUCTURES][OCCUPANCY_ENTRIES_MAX + 1];
+  long loop_mark[NUM_OCC_STRUCTURES][OCCUPANCY_ENTRIES_MAX + 1];    // cycles at the last loop head
+  long loop_period[NUM_OCC_STRUCTURES][OCCUPANCY_ENTRIES_MAX + 1];    // cycles of the last loop iteration
+  int histograms;    // print the histograms, not only the summary
+} OCCUPANCY;
+
+/* Instructions committed with each latency, by opcode class and lifecycle span */
+typedef struct LATENCY
+{
+  long counts[NUM_LAT_CLASSES][NUM_LAT_SPANS][LATENCY_BINS];
+  long sums[NUM_LAT_CLASSES][NUM_LAT_SPANS];    // total cycles, for the mean
+  int max[NUM_LAT_CLASSES][NUM_LAT_SPANS];
+  long loop_mark[NUM_LAT_CLASSES][NUM_LAT_SPANS][LATENCY_BINS];    // counts at the last loop head
+  long loop_period[NUM_LAT_CLASSES][NUM_LAT_SPANS][LATENCY_BINS];    // counts of the last loop iteration
+  long sums_mark[NUM_LAT_CLASSES][NUM_LAT_SPANS];
+  long sums_period[NUM_LAT_CLASSES][NUM_LAT_SPANS];
+  int histograms;    // print the histograms, not only the summary
+} LATENCY;
+
 typedef struct APEX_CPU
 {
   /* Clock cycles elasped */
@@ -200,9 +652,13 @@ typedef struct APEX_CPU
 
   int mul_cycle;
   int mem_cycle;
+  int mem_done_clock;    // clock in which the instruction in MEM completes
   int last_branch_id;
   int last_arith_phys_rd;
   int commitments;
+  int max_cycles;    // number of cycles to simulate
+  int instructions_committed;
+  int flushes;    // times control_flow redirected fetch
 
   /* Current program counter */
   int pc;
@@ -230,17 +686,68 @@ typedef struct APEX_CPU
   /* Code Memory where instructions are stored */
   APEX_Instruction* code_memory;
   int code_memory_size;
+  void* code_map;    // mapping of the object file code memory points into, NULL for text programs
+  long code_map_size;
+  int* code_lines;    // source line of each instruction, NULL for object files
 
   /* Data Memory */
-  int data_memory[4096];
+  DATA_MEMORY memory;
 
   /* Some stats */
   int simulation_completed;
 
+  INTERVAL_MODEL interval;
+
+  LOOP_DETECTOR loop;
+
+  SCHEDULER scheduler;
+
+  CHECKPOINT checkpoint;
+
+  DEVICES devices;
+
+  COMMIT_TRACE trace;
+
+  PIPE_VIEW pipeview;
+
+  CHROME_TRACE chrome;
+
+  TIME_SERIES series;
+
+  LIVE_PAGE live;
+
+  DELTA_DUMP delta;
+
+  DISPATCH_STALLS stalls;
+
+  OCCUPANCY occupancy;
+
+  LATENCY latency;
+
+  TOP_DOWN topdown;
+
+  /* Per instruction counters, NULL unless profiling, see profile_driver.c */
+  struct PROFILE* profile;
+
+  /* Cycles by call stack, NULL unless written, see callstack_driver.c */
+  CALL_STACK call_stack;
+  struct CALL_GRAPH* call_graph;
+
+  /* Messages of TRACE, allocated by the first one, see log_driver.c */
+  struct TRACE_LOG* log;
+
 } APEX_CPU;
 
+/* Data memory words given by the .data directives of a program */
+typedef struct DATA_SEGMENT
+{
+  int start;    // address of the first word
+  int end;    // address after the last word, equal to start if there is no data
+  DATA_MEMORY* memory;    // the words are written here
+} DATA_SEGMENT;
+
 APEX_Instruction*
-create_code_memory(const char* filename, int* size);
+create_code_memory(const char* filename, int* size, DATA_SEGMENT* data, int** lines);
 
 APEX_CPU*
 APEX_cpu_init(const char* filename, const char* function, const int cycles);
@@ -251,6 +758,9 @@ get_source_values(APEX_CPU* cpu, int rs2_exist);
 int
 exception_handler(int code, char* opcode);
 
+void
+APEX_cpu_step(APEX_CPU* cpu);
+
 int
 APEX_cpu_run(APEX_CPU* cpu);
 
@@ -275,4 +785,13 @@ memory(APEX_CPU* cpu);
 void
 print_instruction(int fetch_decode, CPU_Stage* stage);
 
+int
+get_opcode_id(const char* opcode);
+
+const char*
+get_opcode_name(int opcode_id);
+
+int
+get_code_index(int pc);
+
 #endif
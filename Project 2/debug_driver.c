@@ -0,0 +1,245 @@
+/*
+ *  debug_driver.c
+ *  Interactive debugging with stepping back and forth in time
+ *
+ *  While cycles are simulated for the first time, a copy of APEX_CPU is kept
+ *  every SNAPSHOT_INTERVAL cycles in a ring of SNAPSHOTS_NUMBER snapshots. When
+ *  the ring is full every other snapshot is dropped and the interval doubles,
+ *  so snapshots always cover the whole run. Going to an earlier cycle restores
+ *  the nearest snapshot before it and silently re-simulates the cycles in
+ *  between, which costs at most one snapshot interval. Snapshots hold their own
+ *  copy of the written data memory pages. Going back also drops the words
+ *  written to the output stream, the commit trace, the pipeline view and the
+ *  Chrome trace after the restored cycle.
+ *
+ *  Commands are read from stdin:
+ *    step [n]       simulate n cycles, 1 by default
+ *    back [n]       go back n cycles, 1 by default
+ *    goto <cycle>   go to the given cycle, forward or back
+ *    run            simulate until the end
+ *    state          print URF, RAT, IQ, ROB and LSQ
+ *    quit
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "debug_driver.h"
+#include "registers_driver.h"
+#include "iq_driver.h"
+#include "rob_driver.h"
+#include "lsq_driver.h"
+#include "memory_driver.h"
+#include "device_driver.h"
+#include "trace_driver.h"
+#include "pipeview_driver.h"
+#include "chrome_driver.h"
+#include "series_driver.h"
+
+#define SNAPSHOTS_NUMBER 32
+#define SNAPSHOT_INTERVAL 100
+
+extern int ENABLE_DEBUG_MESSAGES;
+
+typedef struct SNAPSHOT_RING
+{
+  APEX_CPU* snapshot[SNAPSHOTS_NUMBER];    // ordered by clock
+  int count;
+  int interval;    // cycles between snapshots
+  int last_clock;    // clock of the latest snapshot
+} SNAPSHOT_RING;
+
+static SNAPSHOT_RING ring;
+
+static void
+init_snapshots()
+{
+  memset(&ring, 0, sizeof(ring));
+  ring.interval = SNAPSHOT_INTERVAL;
+}
+
+static void
+free_snapshots()
+{
+  for (int i = 0; i < SNAPSHOTS_NUMBER; i++) {
+    if (ring.snapshot[i]) {
+      free_data_memory(&ring.snapshot[i]->memory);
+    }
+    free(ring.snapshot[i]);
+  }
+  memset(&ring, 0, sizeof(ring));
+}
+
+/* Keeps every other snapshot, the oldest one included */
+static void
+thin_snapshots()
+{
+  for (int i = 1; i < SNAPSHOTS_NUMBER / 2; i++) {
+    APEX_CPU* kept = ring.snapshot[2 * i];
+    ring.snapshot[2 * i] = ring.snapshot[i];
+    ring.snapshot[i] = kept;
+  }
+  ring.count = SNAPSHOTS_NUMBER / 2;
+  ring.interval *= 2;
+}
+
+static void
+take_snapshot(APEX_CPU* cpu)
+{
+  if (ring.count && cpu->clock < ring.last_clock + ring.interval) {
+    return;
+  }
+  if (ring.count == SNAPSHOTS_NUMBER) {
+    thin_snapshots();
+  }
+  if (!ring.snapshot[ring.count]) {
+    ring.snapshot[ring.count] = malloc(sizeof(APEX_CPU));
+    if (!ring.snapshot[ring.count]) {
+      fprintf(stderr, "APEX_Error : Unable to allocate snapshot\n");
+      return;
+    }
+  }
+  else {
+    free_data_memory(&ring.snapshot[ring.count]->memory);
+  }
+  memcpy(ring.snapshot[ring.count], cpu, sizeof(APEX_CPU));
+  clone_data_memory(&ring.snapshot[ring.count]->memory, &cpu->memory);
+  ring.count++;
+  ring.last_clock = cpu->clock;
+}
+
+/* Restores the latest snapshot taken at or before the given cycle */
+static void
+restore_snapshot(APEX_CPU* cpu, int cycle)
+{
+  int i = ring.count - 1;
+  while (i > 0 && ring.snapshot[i]->clock > cycle) {
+    i--;
+  }
+  /* The trace log goes on, snapshots may be older than it */
+  struct TRACE_LOG* log = cpu->log;
+  free_data_memory(&cpu->memory);
+  memcpy(cpu, ring.snapshot[i], sizeof(APEX_CPU));
+  cpu->log = log;
+  clone_data_memory(&cpu->memory, &ring.snapshot[i]->memory);
+  rewind_output_stream(&cpu->devices);
+  rewind_commit_trace(&cpu->trace);
+  rewind_pipeview(&cpu->pipeview);
+  rewind_chrome_trace(&cpu->chrome);
+  rewind_time_series(&cpu->series);
+}
+
+static int
+can_step(APEX_CPU* cpu)
+{
+  return cpu->clock <= cpu->max_cycles && !cpu->simulation_completed;
+}
+
+static void
+step(APEX_CPU* cpu)
+{
+  take_snapshot(cpu);
+  APEX_cpu_step(cpu);
+}
+
+/*
+ * Brings the CPU to the given cycle and simulates it with debug messages.
+ * Cycles on the way are simulated silently.
+ */
+static void
+goto_cycle(APEX_CPU* cpu, int cycle)
+{
+  if (cycle < 1) {
+    cycle = 1;
+  }
+  if (cycle < cpu->clock) {
+    restore_snapshot(cpu, cycle);
+  }
+
+  int messages = ENABLE_DEBUG_MESSAGES;
+  ENABLE_DEBUG_MESSAGES = 0;
+  while (cpu->clock < cycle && can_step(cpu)) {
+    step(cpu);
+  }
+  ENABLE_DEBUG_MESSAGES = messages;
+
+  if (can_step(cpu)) {
+    step(cpu);
+  }
+}
+
+static void
+display_state(APEX_CPU* cpu)
+{
+  display_registers(cpu);
+  display_iq(cpu);
+  display_rob(cpu);
+  display_lsq(cpu);
+}
+
+int
+APEX_cpu_debug(APEX_CPU* cpu)
+{
+  char line[256];
+  char command[64];
+
+  init_snapshots();
+  printf("APEX_DEBUG : step [n], back [n], goto <cycle>, run, state, quit\n");
+
+  for (;;) {
+    printf("APEX_DEBUG (cycle %d) > ", cpu->clock);
+    fflush(stdout);
+    if (!fgets(line, sizeof(line), stdin)) {
+      break;
+    }
+
+    int n = 1;
+    int args = sscanf(line, "%63s %d", command, &n);
+    if (args < 1) {
+      continue;
+    }
+
+    if (strcmp(command, "step") == 0 || strcmp(command, "s") == 0) {
+      for (int i = 0; i < n && can_step(cpu); i++) {
+        step(cpu);
+      }
+    }
+    else if (strcmp(command, "back") == 0 || strcmp(command, "b") == 0) {
+      /* The last simulated cycle is clock - 1 */
+      goto_cycle(cpu, cpu->clock - 1 - n);
+    }
+    else if ((strcmp(command, "goto") == 0 || strcmp(command, "g") == 0) && args == 2) {
+      goto_cycle(cpu, n);
+    }
+    else if (strcmp(command, "run") == 0 || strcmp(command, "r") == 0) {
+      while (can_step(cpu)) {
+        step(cpu);
+      }
+    }
+    else if (strcmp(command, "state") == 0 || strcmp(command, "p") == 0) {
+      display_state(cpu);
+      continue;
+    }
+    else if (strcmp(command, "quit") == 0 || strcmp(command, "q") == 0) {
+      break;
+    }
+    else {
+      printf("APEX_DEBUG : Unknown command %s", line);
+      continue;
+    }
+
+    if (cpu->simulation_completed) {
+      printf("\n=============================== SIMULATION FINISHED ============================\n");
+    }
+  }
+
+  display_regs_mem(cpu);
+  free_snapshots();
+  return 0;
+}
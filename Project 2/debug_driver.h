@@ -0,0 +1,10 @@
+/*
+ *  debug_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+int
+APEX_cpu_debug(APEX_CPU* cpu);
@@ -0,0 +1,203 @@
+/*
+ *  delta_driver.c
+ *  Delta display of the IQ, ROB, LSQ, RAT and R-RAT
+ *
+ *  With --delta-dump the display prints, in place of the full structures,
+ *  only the entries that changed since it last printed them. Every row
+ *  names its entry and is marked
+ *    +   entry was allocated, followed by its content
+ *    ~   entry changed, followed by its new content
+ *    -   entry was freed
+ *  ROB rows show the status of the result, which the full display does not.
+ *  Head and tail of the ROB and LSQ are printed when they move. The cycles
+ *  an instruction has waited in the IQ are not a change on their own.
+ *
+ *  The structures as last printed are kept in the CPU, so the first display
+ *  after start or a checkpoint restore prints every allocated entry.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "delta_driver.h"
+#include "iq_driver.h"
+#include "rob_driver.h"
+#include "lsq_driver.h"
+
+/* Sets the structures as last printed to empty ones */
+void
+init_delta_dump(APEX_CPU* cpu)
+{
+  DELTA_DUMP* delta = &cpu->delta;
+  memset(delta, 0, sizeof(*delta));
+  for (int i = 0; i < IQ_ENTRIES_NUMBER; i++) {
+    delta->iq.iq_entry[i].free = 1;
+  }
+  for (int i = 0; i < ROB_ENTRIES_NUMBER; i++) {
+    delta->rob.rob_entry[i].free = 1;
+  }
+  for (int i = 0; i < LSQ_ENTRIES_NUMBER; i++) {
+    delta->lsq.lsq_entry[i].free = 1;
+  }
+  delta->rob.head = delta->rob.tail = -1;
+  delta->lsq.head = delta->lsq.tail = -1;
+  for (int i = 0; i < RAT_ENTRIES_NUMBER; i++) {
+    delta->rat[i].phys_reg = -1;
+  }
+  for (int i = 0; i < RRAT_ENTRIES_NUMBER; i++) {
+    delta->rrat[i].commited_phys_reg = -1;
+  }
+}
+
+/* Returns the mark of an entry, 0 if it did not change */
+static char
+entry_mark(int free, int old_free, const void* entry, const void* old_entry, size_t size)
+{
+  if (free && old_free) {
+    return 0;
+  }
+  if (free) {
+    return '-';
+  }
+  if (old_free) {
+    return '+';
+  }
+  return memcmp(entry, old_entry, size) ? '~' : 0;
+}
+
+void
+display_iq_delta(APEX_CPU* cpu)
+{
+  for (int i = 0; i < IQ_ENTRIES_NUMBER; i++) {
+    ISSUE_QUEUE_Entry entry = cpu->iq.iq_entry[i];
+    ISSUE_QUEUE_Entry* old_entry = &cpu->delta.iq.iq_entry[i];
+    entry.counter = old_entry->counter;
+    char mark = entry_mark(entry.free, old_entry->free, &entry, old_entry, sizeof(entry));
+
+    cpu->delta.full_rows += !entry.free;
+    if (mark) {
+      printf("| IQ[%d] %c ", i, mark);
+      if (mark != '-') {
+        print_iq_entry(cpu, i);
+      }
+      else {
+        printf("|");
+      }
+      printf("\n");
+      cpu->delta.rows++;
+    }
+    *old_entry = cpu->iq.iq_entry[i];
+  }
+}
+
+void
+display_rob_delta(APEX_CPU* cpu)
+{
+  ROB* old_rob = &cpu->delta.rob;
+  for (int i = 0; i < ROB_ENTRIES_NUMBER; i++) {
+    ROB_Entry* entry = &cpu->rob.rob_entry[i];
+    char mark = entry_mark(entry->free, old_rob->rob_entry[i].free,
+                           entry, &old_rob->rob_entry[i], sizeof(*entry));
+
+    cpu->delta.full_rows += !entry->free || i == cpu->rob.tail;
+    if (mark) {
+      printf("| ROB[%d] %c |", i, mark);
+      if (mark != '-') {
+        printf(" Status = %d |\t", entry->status);
+        print_rob_entry(cpu, i);
+      }
+      printf("\n");
+      cpu->delta.rows++;
+    }
+    old_rob->rob_entry[i] = *entry;
+  }
+  if (cpu->rob.head != old_rob->head || cpu->rob.tail != old_rob->tail) {
+    printf("| ROB h = %d | t = %d |\n", cpu->rob.head, cpu->rob.tail);
+    old_rob->head = cpu->rob.head;
+    old_rob->tail = cpu->rob.tail;
+  }
+}
+
+void
+display_lsq_delta(APEX_CPU* cpu)
+{
+  LSQ* old_lsq = &cpu->delta.lsq;
+  for (int i = 0; i < LSQ_ENTRIES_NUMBER; i++) {
+    LSQ_Entry* entry = &cpu->lsq.lsq_entry[i];
+    char mark = entry_mark(entry->free, old_lsq->lsq_entry[i].free,
+                           entry, &old_lsq->lsq_entry[i], sizeof(*entry));
+
+    cpu->delta.full_rows += !entry->free || i == cpu->lsq.tail;
+    if (mark) {
+      printf("| LSQ[%d] %c |", i, mark);
+      if (mark != '-') {
+        printf("\t");
+        print_lsq_entry(cpu, i);
+      }
+      printf("\n");
+      cpu->delta.rows++;
+    }
+    old_lsq->lsq_entry[i] = *entry;
+  }
+  if (cpu->lsq.head != old_lsq->head || cpu->lsq.tail != old_lsq->tail) {
+    printf("| LSQ h = %d | t = %d |\n", cpu->lsq.head, cpu->lsq.tail);
+    old_lsq->head = cpu->lsq.head;
+    old_lsq->tail = cpu->lsq.tail;
+  }
+}
+
+/* Changed mappings of a table go on one line, as in the full display */
+static void
+print_mapping(const char* table, int index, int phys_reg, int* changes)
+{
+  if (phys_reg != -1) {
+    printf("| %s[%d] = U%d |", table, index, phys_reg);
+  }
+  else {
+    printf("| %s[%d] = - |", table, index);
+  }
+  (*changes)++;
+}
+
+void
+display_registers_delta(APEX_CPU* cpu)
+{
+  int changes = 0;
+  for (int i = 0; i < RRAT_ENTRIES_NUMBER; i++) {
+    int phys_reg = cpu->rrat[i].commited_phys_reg;
+    cpu->delta.full_rows += phys_reg != -1;
+    if (phys_reg != cpu->delta.rrat[i].commited_phys_reg) {
+      print_mapping("R-RAT", i, phys_reg, &changes);
+      cpu->delta.rrat[i].commited_phys_reg = phys_reg;
+    }
+  }
+  for (int i = 0; i < RAT_ENTRIES_NUMBER; i++) {
+    int phys_reg = cpu->rat[i].phys_reg;
+    cpu->delta.full_rows += phys_reg != -1;
+    if (phys_reg != cpu->delta.rat[i].phys_reg) {
+      print_mapping("RAT", i, phys_reg, &changes);
+      cpu->delta.rat[i].phys_reg = phys_reg;
+    }
+  }
+  if (changes) {
+    printf("\n");
+  }
+  cpu->delta.rows += changes;
+}
+
+void
+display_delta_stats(APEX_CPU* cpu)
+{
+  long full_rows = cpu->delta.full_rows ? cpu->delta.full_rows : 1;
+  printf("\n================================== DELTA DUMP ==================================\n");
+  printf("         |\tEntries printed\t\t|\t%ld\t|\n", cpu->delta.rows);
+  printf("         |\tEntries of full display\t|\t%ld\t|\n", cpu->delta.full_rows);
+  printf("         |\tPrinted\t\t\t|\t%.1f%%\t|\n", 100.0 * cpu->delta.rows / full_rows);
+  printf("================================================================================\n");
+}
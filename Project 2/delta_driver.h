@@ -0,0 +1,25 @@
+/*
+ *  delta_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+void
+init_delta_dump(APEX_CPU* cpu);
+
+void
+display_iq_delta(APEX_CPU* cpu);
+
+void
+display_rob_delta(APEX_CPU* cpu);
+
+void
+display_lsq_delta(APEX_CPU* cpu);
+
+void
+display_registers_delta(APEX_CPU* cpu);
+
+void
+display_delta_stats(APEX_CPU* cpu);
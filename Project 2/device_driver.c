@@ -0,0 +1,182 @@
+/*
+ *  device_driver.c
+ *  Memory-mapped streaming input and output devices
+ *
+ *  The last page of data memory, from DEVICE_BASE_ADDRESS on, belongs to the
+ *  devices instead of memory:
+ *    INPUT_PORT_ADDRESS     LOAD pops the next word of the input stream, 0 at its end
+ *    INPUT_STATUS_ADDRESS   LOAD gives 1 while the input stream has words left
+ *    OUTPUT_PORT_ADDRESS    STORE pushes a word to the output stream
+ *  Other words of the page read as 0 and ignore stores.
+ *
+ *  Streams are files of 32-bit words in host byte order. The input file is
+ *  mapped, so it is paged in as it is read and never held in simulated
+ *  memory. The output file is written through a large stdio buffer.
+ *
+ *  Popping the input can not be undone, so a LOAD from the input port enters
+ *  MEM only once it is the oldest instruction in the ROB (see lsq_driver.c).
+ *  Stores reach MEM after they leave the ROB anyway.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cpu.h"
+#include "device_driver.h"
+#include "memory_driver.h"
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+int
+is_device_address(int address)
+{
+  return address >= DEVICE_BASE_ADDRESS;
+}
+
+int
+open_input_stream(DEVICES* devices, const char* filename)
+{
+  int fd = open(filename, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to open input stream %s\n", filename);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  if (st.st_size % sizeof(int)) {
+    fprintf(stderr, "APEX_Error : Size of input stream %s is not a multiple of 4 bytes\n", filename);
+    close(fd);
+    return -1;
+  }
+
+  devices->input = NULL;
+  devices->input_size = st.st_size;
+  devices->input_words = st.st_size / sizeof(int);
+  devices->input_position = 0;
+  if (devices->input_size) {
+    void* map = mmap(NULL, devices->input_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      fprintf(stderr, "APEX_Error : Unable to map input stream %s\n", filename);
+      close(fd);
+      return -1;
+    }
+    /* Read front to back once */
+    madvise(map, devices->input_size, MADV_SEQUENTIAL);
+    devices->input = map;
+  }
+  close(fd);
+  return 0;
+}
+
+int
+open_output_stream(DEVICES* devices, const char* filename)
+{
+  devices->output = fopen(filename, "wb+");
+  if (!devices->output) {
+    fprintf(stderr, "APEX_Error : Unable to open output stream %s\n", filename);
+    return -1;
+  }
+  setvbuf(devices->output, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+  devices->output_words = 0;
+  return 0;
+}
+
+void
+close_devices(DEVICES* devices)
+{
+  if (devices->input) {
+    munmap((void*)devices->input, devices->input_size);
+  }
+  if (devices->output) {
+    fclose(devices->output);
+  }
+  memset(devices, 0, sizeof(*devices));
+}
+
+/*
+ * Reads a device word. The input port pops from *position, which lets the
+ * functional models read the stream without consuming it for the pipeline.
+ */
+int
+read_device(DEVICES* devices, int address, long* position)
+{
+  if (!devices) {
+    return 0;
+  }
+  if (address == INPUT_PORT_ADDRESS && *position < devices->input_words) {
+    return devices->input[(*position)++];
+  }
+  if (address == INPUT_STATUS_ADDRESS) {
+    return *position < devices->input_words;
+  }
+  return 0;
+}
+
+void
+write_device(DEVICES* devices, int address, int value)
+{
+  if (address != OUTPUT_PORT_ADDRESS) {
+    return;
+  }
+  if (devices->output && fwrite(&value, sizeof(value), 1, devices->output) != 1) {
+    fprintf(stderr, "APEX_Error : Unable to write output stream\n");
+    exit(1);
+  }
+  devices->output_words++;
+}
+
+/* Drops words pushed after the output position was restored to an earlier one */
+void
+rewind_output_stream(DEVICES* devices)
+{
+  if (!devices->output) {
+    return;
+  }
+  long size = devices->output_words * sizeof(int);
+  fflush(devices->output);
+  if (ftruncate(fileno(devices->output), size) != 0 ||
+      fseek(devices->output, size, SEEK_SET) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to rewind output stream\n");
+  }
+}
+
+/* Data memory access of the MEM stage, with the device page mapped in */
+int
+load_word(APEX_CPU* cpu, int address)
+{
+  if (is_device_address(address)) {
+    return read_device(&cpu->devices, address, &cpu->devices.input_position);
+  }
+  return read_memory(&cpu->memory, address);
+}
+
+void
+store_word(APEX_CPU* cpu, int address, int value)
+{
+  if (is_device_address(address)) {
+    write_device(&cpu->devices, address, value);
+    return;
+  }
+  write_memory(&cpu->memory, address, value);
+}
+
+void
+display_device_stats(APEX_CPU* cpu)
+{
+  printf("\n=================================== DEVICES ====================================\n");
+  printf("         |\tInput words read\t|\t%ld of %ld\t|\n",
+         cpu->devices.input_position, cpu->devices.input_words);
+  printf("         |\tOutput words written\t|\t%ld\t|\n", cpu->devices.output_words);
+  printf("================================================================================\n");
+}
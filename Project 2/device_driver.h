@@ -0,0 +1,37 @@
+/*
+ *  device_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+int
+is_device_address(int address);
+
+int
+open_input_stream(DEVICES* devices, const char* filename);
+
+int
+open_output_stream(DEVICES* devices, const char* filename);
+
+void
+close_devices(DEVICES* devices);
+
+int
+read_device(DEVICES* devices, int address, long* position);
+
+void
+write_device(DEVICES* devices, int address, int value);
+
+void
+rewind_output_stream(DEVICES* devices);
+
+int
+load_word(APEX_CPU* cpu, int address);
+
+void
+store_word(APEX_CPU* cpu, int address, int value);
+
+void
+display_device_stats(APEX_CPU* cpu);
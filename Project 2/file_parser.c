@@ -1,6 +1,26 @@
 /*
  *  file_parser.c
  *
+ *  The input file is read once, line by line. Each line is split into tokens
+ *  in place and the instruction is appended to code memory, which grows
+ *  geometrically. Errors report the line they were found on and stop the
+ *  simulator.
+ *
+ *  Besides instructions a line may hold:
+ *    name:                 label, the address of the next instruction or data word
+ *    .text / .data [addr]  switch between code and data memory
+ *    .word expr, ...       data words
+ *    .fill count, expr     count data words of the same value
+ *    .equ name, expr       named constant
+ *    ; comment
+ *
+ *  Literals (#) are constant expressions of numbers, labels, constants and
+ *  "." (address of the current instruction or data word) with + - * / and
+ *  parentheses. A branch target of BZ and BNZ may be written without # as a
+ *  plain expression, e.g. BNZ,loop, which is turned into the PC-relative
+ *  offset. Labels may be used before they are defined; such operands are
+ *  patched once the whole file is read.
+ *
  *  Author :
  *  Ulugbek Ergashev (uergash1@binghamton.edu)
  *  State University of New York, Binghamton
@@ -10,137 +30,609 @@
 #include <string.h>
 
 #include "cpu.h"
+#include "memory_driver.h"
+
+#define INITIAL_CODE_MEMORY_SIZE 1024
+#define INITIAL_SYMBOLS_NUMBER 256
 
 /*
- * This function is related to parsing input file
- *
- * Note : You are not supposed to edit this function
+ * Operands of every opcode, in the order they are written:
+ * d - rd, s - rs1, t - rs2, # - literal, b - branch target
  */
+static const char* operand_formats[NUM_OPCODES] = {
+  [OP_MOVC] = "d#",
+  [OP_ADD] = "dst", [OP_SUB] = "dst", [OP_AND] = "dst",
+  [OP_OR] = "dst", [OP_EXOR] = "dst", [OP_MUL] = "dst",
+  [OP_ADDL] = "ds#", [OP_SUBL] = "ds#",
+  [OP_LOAD] = "ds#",
+  [OP_STORE] = "st#",
+  [OP_BZ] = "b", [OP_BNZ] = "b",
+  [OP_JUMP] = "s#",
+  [OP_JAL] = "ds#",
+  [OP_HALT] = "",
+};
+
+typedef struct SYMBOL
+{
+  char* name;    // NULL if the slot is empty
+  int value;
+} SYMBOL;
+
+/* Operand whose expression uses a label defined later in the file */
+typedef struct FIXUP
+{
+  char* expression;
+  int line_number;
+  int dot;    // value of "." where the expression was written
+  int index;    // instruction index, or data memory address
+  char operand;    // operand format character, 'w' for a data word
+} FIXUP;
+
+typedef struct PARSER
+{
+  const char* filename;
+  int line_number;
+  char* cursor;    // next character of the current line to tokenize
+
+  int in_data;    // 1 after .data, 0 after .text
+  int data_address;    // address of the next data word
+  DATA_SEGMENT* data;
+
+  /* Open addressing hash table, capacity is a power of two */
+  SYMBOL* symbols;
+  int symbols_capacity;
+  int symbols_number;
+
+  FIXUP* fixups;
+  int fixups_capacity;
+  int fixups_number;
+} PARSER;
+
+static void
+parse_error(PARSER* parser, const char* message, const char* token)
+{
+  printf("ERROR >> %s:%d: %s %s\n", parser->filename, parser->line_number, message, token);
+  exit(1);
+}
+
 static int
-get_num_from_string(char* buffer)
+is_blank(char c)
 {
-  char str[16];
-  int j = 0;
-  for (int i = 1; buffer[i] != '\0'; ++i) {
-    str[j] = buffer[i];
-    j++;
-  }
-  str[j] = '\0';
-  return atoi(str);
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static int
+is_end_of_line(char c)
+{
+  return c == '\0' || c == '\r' || c == '\n' || c == ';';
+}
+
+static int
+is_name_start(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static int
+is_name_char(char c)
+{
+  return is_name_start(c) || (c >= '0' && c <= '9');
 }
 
 /*
- * This function is related to parsing input file
- *
- * Note : you can edit this function to add new instructions
+ * Returns the next comma separated token of the line, terminated in place
+ * and without surrounding blanks, or NULL at the end of the line
  */
+static char*
+next_token(PARSER* parser)
+{
+  char* start = parser->cursor;
+  while (*start == ' ' || *start == '\t') {
+    start++;
+  }
+  if (is_end_of_line(*start)) {
+    return NULL;
+  }
+
+  char* end = start;
+  while (*end != ',' && !is_end_of_line(*end)) {
+    end++;
+  }
+  if (*end == ',') {
+    parser->cursor = end + 1;
+  }
+  else {
+    /* Nothing follows the last token, comments included */
+    *end = '\0';
+    parser->cursor = end;
+  }
+
+  while (end > start && is_blank(end[-1])) {
+    end--;
+  }
+  *end = '\0';
+  return start;
+}
+
+/* ----------------------------- Symbol table ----------------------------- */
+
+static unsigned int
+hash_name(const char* name, int length)
+{
+  unsigned int hash = 5381;
+  for (int i = 0; i < length; i++) {
+    hash = hash * 33 + (unsigned char)name[i];
+  }
+  return hash;
+}
+
+static SYMBOL*
+find_symbol_slot(SYMBOL* symbols, int capacity, const char* name, int length)
+{
+  unsigned int i = hash_name(name, length) & (capacity - 1);
+  while (symbols[i].name &&
+         (strncmp(symbols[i].name, name, length) != 0 || symbols[i].name[length] != '\0')) {
+    i = (i + 1) & (capacity - 1);
+  }
+  return &symbols[i];
+}
+
+static SYMBOL*
+find_symbol(PARSER* parser, const char* name, int length)
+{
+  SYMBOL* slot = find_symbol_slot(parser->symbols, parser->symbols_capacity, name, length);
+  return slot->name ? slot : NULL;
+}
+
 static void
-create_APEX_instruction(APEX_Instruction* ins, char* buffer)
+define_symbol(PARSER* parser, const char* name, int value)
+{
+  int length = strlen(name);
+  if (!is_name_start(name[0])) {
+    parse_error(parser, "Invalid label", name);
+  }
+  if (find_symbol(parser, name, length)) {
+    parse_error(parser, "Duplicate label", name);
+  }
+
+  /* Keep the table at most half full */
+  if (2 * (parser->symbols_number + 1) > parser->symbols_capacity) {
+    int old_capacity = parser->symbols_capacity;
+    SYMBOL* old_symbols = parser->symbols;
+    parser->symbols_capacity = old_capacity * 2;
+    parser->symbols = calloc(parser->symbols_capacity, sizeof(SYMBOL));
+    if (!parser->symbols) {
+      parse_error(parser, "Out of memory at label", name);
+    }
+    for (int i = 0; i < old_capacity; i++) {
+      if (old_symbols[i].name) {
+        *find_symbol_slot(parser->symbols, parser->symbols_capacity, old_symbols[i].name,
+                          strlen(old_symbols[i].name)) = old_symbols[i];
+      }
+    }
+    free(old_symbols);
+  }
+
+  SYMBOL* slot = find_symbol_slot(parser->symbols, parser->symbols_capacity, name, length);
+  slot->name = strdup(name);
+  slot->value = value;
+  parser->symbols_number++;
+}
+
+/* ------------------------------ Expressions ----------------------------- */
+
+typedef struct EXPRESSION
+{
+  PARSER* parser;
+  const char* text;    // whole expression, for error messages
+  const char* p;
+  int dot;
+  int unresolved;    // a label is not defined yet
+} EXPRESSION;
+
+static int parse_sum(EXPRESSION* e);
+
+static void
+skip_blanks(EXPRESSION* e)
+{
+  while (*e->p == ' ' || *e->p == '\t') {
+    e->p++;
+  }
+}
+
+static int
+parse_primary(EXPRESSION* e)
 {
-  char* token = strtok(buffer, ",");
-  int token_num = 0;
-  char tokens[6][128];
-  while (token != NULL) {
-    strcpy(tokens[token_num], token);
-    token_num++;
-    token = strtok(NULL, ",");
+  skip_blanks(e);
+  char c = *e->p;
+
+  if (c == '-' || c == '+') {
+    e->p++;
+    int value = parse_primary(e);
+    return c == '-' ? -value : value;
   }
 
-  strcpy(ins->opcode, tokens[0]);
+  if (c == '(') {
+    e->p++;
+    int value = parse_sum(e);
+    skip_blanks(e);
+    if (*e->p != ')') {
+      parse_error(e->parser, "Missing ) in", e->text);
+    }
+    e->p++;
+    return value;
+  }
 
-  if (strcmp(ins->opcode, "MOVC") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
+  if (c >= '0' && c <= '9') {
+    int value = 0;
+    if (c == '0' && (e->p[1] == 'x' || e->p[1] == 'X')) {
+      int digits = 0;
+      for (e->p += 2;; e->p++, digits++) {
+        char h = *e->p;
+        if (h >= '0' && h <= '9') { value = value * 16 + (h - '0'); }
+        else if (h >= 'a' && h <= 'f') { value = value * 16 + (h - 'a' + 10); }
+        else if (h >= 'A' && h <= 'F') { value = value * 16 + (h - 'A' + 10); }
+        else { break; }
+      }
+      if (!digits) {
+        parse_error(e->parser, "Invalid number in", e->text);
+      }
+      return value;
+    }
+    while (*e->p >= '0' && *e->p <= '9') {
+      value = value * 10 + (*e->p - '0');
+      e->p++;
+    }
+    return value;
+  }
+
+  if (c == '.' && !is_name_char(e->p[1])) {
+    e->p++;
+    return e->dot;
+  }
+
+  if (is_name_start(c)) {
+    const char* name = e->p;
+    while (is_name_char(*e->p)) {
+      e->p++;
+    }
+    SYMBOL* symbol = find_symbol(e->parser, name, e->p - name);
+    if (!symbol) {
+      e->unresolved = 1;
+      return 0;
+    }
+    return symbol->value;
+  }
+
+  parse_error(e->parser, "Invalid expression", e->text);
+  return 0;
+}
+
+static int
+parse_product(EXPRESSION* e)
+{
+  int value = parse_primary(e);
+  for (;;) {
+    skip_blanks(e);
+    char op = *e->p;
+    if (op != '*' && op != '/') {
+      return value;
+    }
+    e->p++;
+    int right = parse_primary(e);
+    if (op == '*') {
+      value *= right;
+    }
+    else if (right != 0) {
+      value /= right;
+    }
+    else if (!e->unresolved) {
+      parse_error(e->parser, "Division by zero in", e->text);
+    }
+  }
+}
 
-    if (ins->rd > 15 || ins->rd < 0) {
-      exception_handler(1, ins->opcode);
+static int
+parse_sum(EXPRESSION* e)
+{
+  int value = parse_product(e);
+  for (;;) {
+    skip_blanks(e);
+    char op = *e->p;
+    if (op != '+' && op != '-') {
+      return value;
     }
+    e->p++;
+    int right = parse_product(e);
+    value = (op == '+') ? value + right : value - right;
+  }
+}
 
-    ins->imm = get_num_from_string(tokens[2]);
+/* Evaluates the expression. Sets *unresolved if it uses an undefined label */
+static int
+evaluate(PARSER* parser, const char* text, int dot, int* unresolved)
+{
+  EXPRESSION e = { parser, text, text, dot, 0 };
+  int value = parse_sum(&e);
+  skip_blanks(&e);
+  if (*e.p != '\0') {
+    parse_error(parser, "Invalid expression", text);
   }
+  *unresolved = e.unresolved;
+  return value;
+}
+
+/* Evaluates an expression that has to be known at this point of the file */
+static int
+evaluate_now(PARSER* parser, const char* text, int dot)
+{
+  int unresolved;
+  int value = evaluate(parser, text, dot, &unresolved);
+  if (unresolved) {
+    parse_error(parser, "Label used before it is defined in", text);
+  }
+  return value;
+}
 
-  if (strcmp(ins->opcode, "STORE") == 0) {
-    ins->rs1 = get_num_from_string(tokens[1]);
-    ins->rs2 = get_num_from_string(tokens[2]);
+static void
+add_fixup(PARSER* parser, const char* expression, int dot, int index, char operand)
+{
+  if (parser->fixups_number == parser->fixups_capacity) {
+    parser->fixups_capacity = parser->fixups_capacity ? parser->fixups_capacity * 2 : INITIAL_SYMBOLS_NUMBER;
+    FIXUP* grown = realloc(parser->fixups, sizeof(FIXUP) * parser->fixups_capacity);
+    if (!grown) {
+      parse_error(parser, "Out of memory at", expression);
+    }
+    parser->fixups = grown;
+  }
+  FIXUP* fixup = &parser->fixups[parser->fixups_number++];
+  fixup->expression = strdup(expression);
+  fixup->line_number = parser->line_number;
+  fixup->dot = dot;
+  fixup->index = index;
+  fixup->operand = operand;
+}
 
-   if ((ins->rs1 > 15 || ins->rs1 < 0) ||
-       (ins->rs2 > 15 || ins->rs2 < 0)) {
-      exception_handler(1, ins->opcode);
-   }
+/* ------------------------------- Operands ------------------------------- */
 
-   ins->imm = get_num_from_string(tokens[3]);
+/* Parses the number after the prefix character R of a register */
+static int
+parse_register(PARSER* parser, const char* token, const char* opcode)
+{
+  const char* p = token + 1;
+  if (token[0] != 'R') {
+    parse_error(parser, "Expected register, got", token);
   }
+  if (*p < '0' || *p > '9') {
+    parse_error(parser, "Invalid number", token);
+  }
+  int reg = 0;
+  while (*p >= '0' && *p <= '9' && reg <= 15) {
+    reg = reg * 10 + (*p - '0');
+    p++;
+  }
+  if (reg > 15) {
+    printf("ERROR >> %s:%d: Invalid register input for %s (Register range is within 0-15)\n",
+           parser->filename, parser->line_number, opcode);
+    exit(1);
+  }
+  if (*p != '\0') {
+    parse_error(parser, "Invalid number", token);
+  }
+  return reg;
+}
 
-  if (strcmp(ins->opcode, "LOAD") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->imm = get_num_from_string(tokens[3]);
+static int
+resolve_literal(const char* token, char operand, int value, int dot)
+{
+  /* A branch target without # is an address, the instruction holds the offset */
+  if (operand == 'b' && token[0] != '#') {
+    return value - dot;
   }
+  return value;
+}
 
-  if (strcmp(ins->opcode, "ADD") == 0 ||
-      strcmp(ins->opcode, "SUB") == 0 ||
-      strcmp(ins->opcode, "AND") == 0 ||
-      strcmp(ins->opcode, "OR") == 0 ||
-      strcmp(ins->opcode, "EX-OR") == 0 ||
-      strcmp(ins->opcode, "MUL") == 0) {
+/* Parses a literal or branch target, leaving a fixup if it uses a later label */
+static int
+parse_literal(PARSER* parser, const char* token, char operand, int index, int dot)
+{
+  const char* expression = token;
+  if (token[0] == '#') {
+    expression = token + 1;
+  }
+  else if (operand != 'b') {
+    parse_error(parser, "Expected literal, got", token);
+  }
+  if (*expression == '\0') {
+    parse_error(parser, "Expected literal, got", token);
+  }
 
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->rs2 = get_num_from_string(tokens[3]);
+  int unresolved;
+  int value = evaluate(parser, expression, dot, &unresolved);
+  if (unresolved) {
+    add_fixup(parser, token, dot, index, operand);
+    return 0;
+  }
+  return resolve_literal(token, operand, value, dot);
+}
+
+static void
+create_APEX_instruction(PARSER* parser, APEX_Instruction* ins, int index, char* opcode)
+{
+  int pc = 4000 + 4 * index;
 
-    if ((ins->rs1 > 15 || ins->rs1 < 0) ||
-        (ins->rs2 > 15 || ins->rs2 < 0) ||
-        (ins->rd > 15 || ins->rd < 0)) {
-      exception_handler(1, ins->opcode);
+  memset(ins, 0, sizeof(*ins));
+  ins->opcode_id = get_opcode_id(opcode);
+  if (ins->opcode_id == OP_UNKNOWN) {
+    parse_error(parser, "Unknown instruction", opcode);
+  }
+
+  const char* format = operand_formats[ins->opcode_id];
+  for (int i = 0; format[i] != '\0'; i++) {
+    char* token = next_token(parser);
+    if (!token) {
+      parse_error(parser, "Missing operands for", opcode);
+    }
+    switch (format[i]) {
+      case 'd': ins->rd = parse_register(parser, token, opcode); break;
+      case 's': ins->rs1 = parse_register(parser, token, opcode); break;
+      case 't': ins->rs2 = parse_register(parser, token, opcode); break;
+      default: ins->imm = parse_literal(parser, token, format[i], index, pc); break;
     }
   }
 
-  if (strcmp(ins->opcode, "ADDL") == 0 ||
-      strcmp(ins->opcode, "SUBL") == 0)  {
+  /* "HALT," and the like end with an empty operand */
+  char* extra = next_token(parser);
+  if (extra && *extra != '\0') {
+    parse_error(parser, "Too many operands for", opcode);
+  }
+}
+
+/* ------------------------------ Directives ------------------------------ */
 
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->imm = get_num_from_string(tokens[3]);
+static void
+put_data_word(PARSER* parser, int value)
+{
+  DATA_SEGMENT* data = parser->data;
+  int address = parser->data_address;
+  if (address < 0) {
+    parse_error(parser, "Data is out of memory range at", ".data");
+  }
+  if (data->start == data->end) {
+    data->start = address;
+    data->end = address;
+  }
+  if (address < data->start) {
+    data->start = address;
+  }
+  if (address >= data->end) {
+    data->end = address + 1;
+  }
+  write_memory(data->memory, address, value);
+  parser->data_address++;
+}
 
-    if ((ins->rs1 > 15 || ins->rs1 < 0) ||
-        (ins->rd > 15 || ins->rd < 0)) {
-      exception_handler(1, ins->opcode);
+static void
+parse_directive(PARSER* parser, char* directive)
+{
+  /* The first operand is separated from the directive name by a blank */
+  char* operand = directive;
+  while (*operand && !is_blank(*operand)) {
+    operand++;
+  }
+  if (*operand) {
+    *operand++ = '\0';
+    while (is_blank(*operand)) {
+      operand++;
     }
   }
+  if (*operand == '\0') {
+    operand = NULL;
+  }
 
-  if (strcmp(ins->opcode, "BZ") == 0 ||
-      strcmp(ins->opcode, "BNZ") == 0) {
-    ins->imm = get_num_from_string(tokens[1]);
+  if (strcmp(directive, ".text") == 0) {
+    if (operand) {
+      parse_error(parser, "Unexpected operand for", directive);
+    }
+    parser->in_data = 0;
+    return;
   }
 
-  if (strcmp(ins->opcode, "JUMP") == 0) {
-    ins->rs1 = get_num_from_string(tokens[1]);
+  if (strcmp(directive, ".data") == 0) {
+    parser->in_data = 1;
+    if (operand) {
+      parser->data_address = evaluate_now(parser, operand, parser->data_address);
+    }
+    return;
+  }
 
-    if (ins->rs1 > 15 || ins->rs1 < 0) {
-      exception_handler(1, ins->opcode);
+  if (strcmp(directive, ".equ") == 0) {
+    char* value = next_token(parser);
+    if (!operand || !value) {
+      parse_error(parser, "Missing operands for", directive);
     }
+    define_symbol(parser, operand, evaluate_now(parser, value, parser->data_address));
+    return;
+  }
 
-    ins->imm = get_num_from_string(tokens[2]);
+  if (strcmp(directive, ".word") != 0 && strcmp(directive, ".fill") != 0) {
+    parse_error(parser, "Unknown directive", directive);
+  }
+  if (!parser->in_data) {
+    parse_error(parser, "Data directive outside of .data:", directive);
+  }
+  if (!operand) {
+    parse_error(parser, "Missing operands for", directive);
   }
 
-  if (strcmp(ins->opcode, "JAL") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
+  if (strcmp(directive, ".fill") == 0) {
+    char* value = next_token(parser);
+    if (!value) {
+      parse_error(parser, "Missing operands for", directive);
+    }
+    int count = evaluate_now(parser, operand, parser->data_address);
+    int word = evaluate_now(parser, value, parser->data_address);
+    for (int i = 0; i < count; i++) {
+      put_data_word(parser, word);
+    }
+    return;
+  }
 
-    if (ins->rs1 > 15 || ins->rs1 < 0) {
-      exception_handler(1, ins->opcode);
+  for (; operand; operand = next_token(parser)) {
+    int unresolved;
+    int value = evaluate(parser, operand, parser->data_address, &unresolved);
+    if (unresolved) {
+      add_fixup(parser, operand, parser->data_address, parser->data_address, 'w');
     }
+    put_data_word(parser, value);
+  }
+}
+
+/* Patches operands that use labels defined after them */
+static void
+apply_fixups(PARSER* parser, APEX_Instruction* code_memory)
+{
+  for (int i = 0; i < parser->fixups_number; i++) {
+    FIXUP* fixup = &parser->fixups[i];
+    const char* expression = fixup->expression;
+    if (expression[0] == '#') {
+      expression++;
+    }
+
+    int unresolved;
+    parser->line_number = fixup->line_number;
+    int value = evaluate(parser, expression, fixup->dot, &unresolved);
+    if (unresolved) {
+      parse_error(parser, "Undefined label in", expression);
+    }
+    if (fixup->operand == 'w') {
+      write_memory(parser->data->memory, fixup->index, value);
+    }
+    else {
+      code_memory[fixup->index].imm = resolve_literal(fixup->expression, fixup->operand, value, fixup->dot);
+    }
+    free(fixup->expression);
+  }
+}
 
-    ins->imm = get_num_from_string(tokens[3]);
+static void
+free_parser(PARSER* parser)
+{
+  for (int i = 0; i < parser->symbols_capacity; i++) {
+    free(parser->symbols[i].name);
   }
+  free(parser->symbols);
+  free(parser->fixups);
 }
 
 /*
  * This function is related to parsing input file
  *
- * Note : You are not supposed to edit this function
+ * Blank lines are skipped, every other line holds at most one instruction.
+ * Contents of data memory given by the data directives are left in data.
  */
 APEX_Instruction*
-create_code_memory(const char* filename, int* size)
+create_code_memory(const char* filename, int* size, DATA_SEGMENT* data, int** lines)
 {
   if (!filename) {
     return NULL;
@@ -151,35 +643,101 @@ create_code_memory(const char* filename, int* size)
     return NULL;
   }
 
+  PARSER parser;
+  memset(&parser, 0, sizeof(parser));
+  parser.filename = filename;
+  parser.data = data;
+  parser.symbols_capacity = INITIAL_SYMBOLS_NUMBER;
+  parser.symbols = calloc(parser.symbols_capacity, sizeof(SYMBOL));
+  data->start = 0;
+  data->end = 0;
+
   char* line = NULL;
   size_t len = 0;
-  ssize_t nread;
+  int capacity = INITIAL_CODE_MEMORY_SIZE;
   int code_memory_size = 0;
+  APEX_Instruction* code_memory = malloc(sizeof(*code_memory) * capacity);
+  int* code_lines = lines ? malloc(sizeof(*code_lines) * capacity) : NULL;
+  if (lines && !code_lines) {
+    free(code_memory);
+    code_memory = NULL;
+  }
 
-  while ((nread = getline(&line, &len, fp)) != -1) {
+  while (code_memory && parser.symbols && getline(&line, &len, fp) != -1) {
+    parser.line_number++;
+    parser.cursor = line;
+    char* token = next_token(&parser);
+    if (!token) {
+      continue;
+    }
+
+    /* Label in front of the instruction or directive */
+    char* colon = token;
+    while (is_name_char(*colon)) {
+      colon++;
+    }
+    if (*colon == ':' && colon != token) {
+      *colon = '\0';
+      define_symbol(&parser, token, parser.in_data ? parser.data_address : 4000 + 4 * code_memory_size);
+      token = colon + 1;
+      while (is_blank(*token)) {
+        token++;
+      }
+      if (*token == '\0') {
+        continue;
+      }
+    }
+
+    if (token[0] == '.') {
+      parse_directive(&parser, token);
+      continue;
+    }
+    if (parser.in_data) {
+      parse_error(&parser, "Instruction inside of .data:", token);
+    }
+
+    if (code_memory_size == capacity) {
+      capacity *= 2;
+      APEX_Instruction* grown = realloc(code_memory, sizeof(*code_memory) * capacity);
+      if (!grown) {
+        free(code_memory);
+        code_memory = NULL;
+        break;
+      }
+      code_memory = grown;
+      if (code_lines) {
+        int* grown_lines = realloc(code_lines, sizeof(*code_lines) * capacity);
+        if (!grown_lines) {
+          free(code_memory);
+          code_memory = NULL;
+          break;
+        }
+        code_lines = grown_lines;
+      }
+    }
+    if (code_lines) {
+      code_lines[code_memory_size] = parser.line_number;
+    }
+    create_APEX_instruction(&parser, &code_memory[code_memory_size], code_memory_size, token);
     code_memory_size++;
   }
-  *size = code_memory_size;
-  if (!code_memory_size) {
-    fclose(fp);
-    return NULL;
+
+  free(line);
+  fclose(fp);
+
+  if (code_memory) {
+    apply_fixups(&parser, code_memory);
   }
+  free_parser(&parser);
 
-  APEX_Instruction* code_memory =
-    malloc(sizeof(*code_memory) * code_memory_size);
-  if (!code_memory) {
-    fclose(fp);
+  *size = code_memory_size;
+  if (!code_memory_size || !code_memory) {
+    free(code_memory);
+    free(code_lines);
     return NULL;
   }
-
-  rewind(fp);
-  int current_instruction = 0;
-  while ((nread = getline(&line, &len, fp)) != -1) {
-    create_APEX_instruction(&code_memory[current_instruction], line);
-    current_instruction++;
+  if (lines) {
+    *lines = code_lines;
   }
-
-  free(line);
-  fclose(fp);
   return code_memory;
 }
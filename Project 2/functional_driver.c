@@ -0,0 +1,148 @@
+/*
+ *  functional_driver.c
+ *  Executes APEX instructions architecturally, without any timing
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "functional_driver.h"
+#include "memory_driver.h"
+#include "device_driver.h"
+
+void
+init_functional_state(FUNCTIONAL_STATE* state, DATA_MEMORY* memory)
+{
+  memset(state, 0, sizeof(*state));
+  state->flag_reg = -1;
+  state->memory = memory;
+}
+
+static int
+check_address(int address, char* opcode)
+{
+  if (address < 0) {
+    exception_handler(0, opcode);
+  }
+  return address;
+}
+
+static void
+write_register(FUNCTIONAL_STATE* state, int rd, int value, int sets_flag)
+{
+  state->regs[rd] = value;
+  if (sets_flag) {
+    state->flag_value = value;
+    state->flag_reg = rd;
+  }
+  else if (state->flag_reg == rd) {
+    state->flag_reg = -1;
+  }
+}
+
+/*
+ * Executes one instruction and returns PC of the next one.
+ * BZ and BNZ test the result of the last ADD, SUB, MUL, ADDL or SUBL,
+ * the same way as the pipeline does.
+ */
+int
+functional_step(FUNCTIONAL_STATE* state, APEX_Instruction* ins, int pc)
+{
+  int rs1_value = state->regs[ins->rs1];
+  int rs2_value = state->regs[ins->rs2];
+  int rd = ins->rd;
+  int next_pc = pc + 4;
+
+  state->taken = 0;
+  state->mem_address = -1;
+
+  switch (ins->opcode_id) {
+    case OP_MOVC:
+      write_register(state, rd, ins->imm, 0);
+      break;
+
+    case OP_ADD:
+      write_register(state, rd, rs1_value + rs2_value, 1);
+      break;
+
+    case OP_SUB:
+      write_register(state, rd, rs1_value - rs2_value, 1);
+      break;
+
+    case OP_AND:
+      write_register(state, rd, rs1_value & rs2_value, 0);
+      break;
+
+    case OP_OR:
+      write_register(state, rd, rs1_value | rs2_value, 0);
+      break;
+
+    case OP_EXOR:
+      write_register(state, rd, rs1_value ^ rs2_value, 0);
+      break;
+
+    case OP_MUL:
+      write_register(state, rd, rs1_value * rs2_value, 1);
+      break;
+
+    case OP_ADDL:
+      write_register(state, rd, rs1_value + ins->imm, 1);
+      break;
+
+    case OP_SUBL:
+      write_register(state, rd, rs1_value - ins->imm, 1);
+      break;
+
+    case OP_LOAD:
+      state->mem_address = check_address(rs1_value + ins->imm, "LOAD");
+      if (is_device_address(state->mem_address)) {
+        write_register(state, rd, read_device(state->devices, state->mem_address, &state->input_position), 0);
+      }
+      else {
+        write_register(state, rd, read_memory(state->memory, state->mem_address), 0);
+      }
+      break;
+
+    case OP_STORE:
+      state->mem_address = check_address(rs2_value + ins->imm, "STORE");
+      /* Output of the functional models is dropped */
+      if (!is_device_address(state->mem_address)) {
+        state->mem_old_value = read_memory(state->memory, state->mem_address);
+        write_memory(state->memory, state->mem_address, rs1_value);
+      }
+      break;
+
+    case OP_BZ:
+      if (state->flag_value == 0) {
+        next_pc = pc + ins->imm;
+        state->taken = 1;
+      }
+      break;
+
+    case OP_BNZ:
+      if (state->flag_value != 0) {
+        next_pc = pc + ins->imm;
+        state->taken = 1;
+      }
+      break;
+
+    case OP_JUMP:
+      next_pc = rs1_value + ins->imm;
+      state->taken = 1;
+      break;
+
+    case OP_JAL:
+      write_register(state, rd, pc + 4, 0);
+      next_pc = rs1_value + ins->imm;
+      state->taken = 1;
+      break;
+  }
+
+  return next_pc;
+}
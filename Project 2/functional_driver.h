@@ -0,0 +1,13 @@
+/*
+ *  functional_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+void
+init_functional_state(FUNCTIONAL_STATE* state, DATA_MEMORY* memory);
+
+int
+functional_step(FUNCTIONAL_STATE* state, APEX_Instruction* ins, int pc);
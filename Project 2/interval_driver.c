@@ -0,0 +1,499 @@
+/*
+ *  interval_driver.c
+ *  Analytical interval model - fast timing estimate of the pipeline
+ *
+ *  Instructions are executed in program order by functional_driver.c and each
+ *  one is charged for the cycle in which it can be dispatched, issued, completed
+ *  and committed. Dispatch proceeds at one instruction per cycle and is delayed by
+ *  front end redirects (taken branches, JUMP and JAL), by ROB, IQ and LSQ being
+ *  full, where an entry is released when the instruction that holds it commits,
+ *  issues or goes to MEM, and by BIS being full for branches. Latencies follow
+ *  the detailed pipeline in cpu.c.
+ *
+ *  The same model can be driven by a commit trace instead of functional
+ *  execution (replay mode). Structure sizes can then be varied per run, so one
+ *  trace serves a sweep over configurations.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "interval_driver.h"
+#include "functional_driver.h"
+#include "memory_driver.h"
+#include "trace_driver.h"
+
+/* Reservation tables of function units, indexed by cycle modulo the window */
+#define FU_WINDOW 64
+
+static int int_fu_slots[FU_WINDOW];
+static int mul_fu_slots[FU_WINDOW];
+
+static int
+max_of(int a, int b)
+{
+  return a > b ? a : b;
+}
+
+/* Finds the first cycle >= earliest where the FU is free for duration cycles
+ * and reserves it
+ */
+static int
+reserve_fu(int* slots, int earliest, int duration)
+{
+  int cycle = earliest;
+  for (;;) {
+    int free = 1;
+    for (int i = 0; i < duration; i++) {
+      if (slots[(cycle + i) % FU_WINDOW] == cycle + i) {
+        free = 0;
+        break;
+      }
+    }
+    if (free) {
+      break;
+    }
+    cycle++;
+  }
+  for (int i = 0; i < duration; i++) {
+    slots[(cycle + i) % FU_WINDOW] = cycle + i;
+  }
+  return cycle;
+}
+
+static int
+commit_slot(INTERVAL_MODEL* model, int earliest)
+{
+  int cycle = max_of(earliest, model->last_commit);
+  if (cycle == model->last_commit) {
+    if (model->commits_in_last_cycle == COMMIT_WIDTH) {
+      cycle++;
+      model->commits_in_last_cycle = 0;
+    }
+  }
+  else {
+    model->commits_in_last_cycle = 0;
+  }
+  model->commits_in_last_cycle++;
+  model->last_commit = cycle;
+  return cycle;
+}
+
+/* Sizes of the detailed pipeline */
+void
+default_model_config(MODEL_CONFIG* config)
+{
+  config->rob_entries = ROB_ENTRIES_NUMBER;
+  config->iq_entries = IQ_ENTRIES_NUMBER;
+  config->lsq_entries = LSQ_ENTRIES_NUMBER;
+  config->bis_entries = BIS_ENTRIES_NUMBER;
+}
+
+/*
+ * Parses a configuration of the form rob=<n>,iq=<n>,lsq=<n>,bis=<n>, sizes
+ * that are not given keep the pipeline sizes. Returns 0 on success.
+ */
+int
+parse_model_config(const char* argument, MODEL_CONFIG* config)
+{
+  default_model_config(config);
+  const char* p = argument;
+  while (*p) {
+    char name[16];
+    int value;
+    int length;
+    if (sscanf(p, "%15[a-z]=%d%n", name, &value, &length) != 2 ||
+        value < 1 || value > MODEL_ENTRIES_MAX) {
+      fprintf(stderr, "APEX_Error : Expected rob=<n>,iq=<n>,lsq=<n>,bis=<n> with 1 - %d entries, got %s\n",
+              MODEL_ENTRIES_MAX, argument);
+      return -1;
+    }
+    if (strcmp(name, "rob") == 0) {
+      config->rob_entries = value;
+    }
+    else if (strcmp(name, "iq") == 0) {
+      config->iq_entries = value;
+    }
+    else if (strcmp(name, "lsq") == 0) {
+      config->lsq_entries = value;
+    }
+    else if (strcmp(name, "bis") == 0) {
+      config->bis_entries = value;
+    }
+    else {
+      fprintf(stderr, "APEX_Error : Unknown structure %s in %s\n", name, argument);
+      return -1;
+    }
+    p += length;
+    if (*p == ',') {
+      p++;
+    }
+  }
+  return 0;
+}
+
+static void
+init_timing(INTERVAL_MODEL* model, MODEL_CONFIG* config)
+{
+  memset(model, 0, sizeof(*model));
+  model->config = *config;
+
+  for (int i = 0; i < FU_WINDOW; i++) {
+    int_fu_slots[i] = -1;
+    mul_fu_slots[i] = -1;
+  }
+
+  /* First instruction is fetched in cycle 1 and dispatched in cycle 2 */
+  model->fetch_ready = 1;
+  model->last_dispatch = 1;
+  model->last_commit = 0;
+}
+
+static void
+init_interval_model(APEX_CPU* cpu)
+{
+  INTERVAL_MODEL* model = &cpu->interval;
+  MODEL_CONFIG config;
+  default_model_config(&config);
+  init_timing(model, &config);
+  clone_data_memory(&model->memory, &cpu->memory);
+  init_functional_state(&model->state, &model->memory);
+  model->state.devices = &cpu->devices;
+  model->state.input_position = cpu->devices.input_position;
+}
+
+/*
+ * Charges one instruction in program order. taken tells whether it
+ * redirected the PC. Returns 1 once HALT commits, -1 if the instruction
+ * is not dispatched within the simulated cycles, 0 otherwise.
+ */
+static int
+time_instruction(APEX_CPU* cpu, INTERVAL_MODEL* model, APEX_Instruction* ins, int taken)
+{
+  MODEL_CONFIG* config = &model->config;
+  int op = ins->opcode_id;
+  int is_mem = (op == OP_LOAD || op == OP_STORE);
+  int is_branch = (op == OP_BZ || op == OP_BNZ || op == OP_JUMP || op == OP_JAL);
+  int uses_iq = (op != OP_HALT);
+
+  /* Dispatch, bounded by front end and by free ROB, IQ, LSQ and BIS entries */
+  int in_order = model->last_dispatch + 1;
+  int frontend = model->fetch_ready + 1;
+  int rob = model->rob_release[model->rob_count % config->rob_entries];
+  int rob_load = model->rob_is_load[model->rob_count % config->rob_entries];
+  int iq = uses_iq ? model->iq_release[model->iq_count % config->iq_entries] : 0;
+  int lsq = is_mem ? model->lsq_release[model->lsq_count % config->lsq_entries] : 0;
+  int bis = is_branch ? model->bis_release[model->bis_count % config->bis_entries] : 0;
+
+  int dispatch = max_of(max_of(in_order, frontend), max_of(max_of(rob, bis), max_of(iq, lsq)));
+  if (dispatch > cpu->max_cycles) {
+    return -1;
+  }
+
+  int penalty = dispatch - in_order;
+  if (penalty > 0) {
+    if (dispatch == frontend) {
+      model->branch_penalty += penalty;
+    }
+    else if (dispatch == rob) {
+      if (rob_load) {
+        model->load_penalty += penalty;
+      }
+      else {
+        model->rob_penalty += penalty;
+      }
+    }
+    else if (dispatch == iq) {
+      model->iq_penalty += penalty;
+    }
+    else if (dispatch == lsq) {
+      model->lsq_penalty += penalty;
+    }
+    else {
+      model->bis_penalty += penalty;
+    }
+  }
+  model->base_cycles++;
+  model->last_dispatch = dispatch;
+
+  /* Issue waits for the source operands */
+  int earliest = dispatch + 1;
+  int rs1_ready = model->reg_ready[ins->rs1];
+  int rs2_ready = model->reg_ready[ins->rs2];
+  int issue = 0;
+  int complete = 0;
+  int commit = 0;
+  int writes_rd = 0;
+  int sets_flag = 0;
+  int halted = 0;
+
+  switch (op) {
+    case OP_MOVC:
+      writes_rd = 1;
+      break;
+
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+      sets_flag = 1;
+      /* fall through */
+    case OP_AND:
+    case OP_OR:
+    case OP_EXOR:
+      earliest = max_of(earliest, max_of(rs1_ready, rs2_ready));
+      writes_rd = 1;
+      break;
+
+    case OP_ADDL:
+    case OP_SUBL:
+      sets_flag = 1;
+      /* fall through */
+    case OP_LOAD:
+    case OP_JAL:
+      earliest = max_of(earliest, rs1_ready);
+      writes_rd = 1;
+      break;
+
+    case OP_STORE:
+      earliest = max_of(earliest, max_of(rs1_ready, rs2_ready));
+      break;
+
+    case OP_BZ:
+    case OP_BNZ:
+      earliest = max_of(earliest, model->flag_ready);
+      break;
+
+    case OP_JUMP:
+      earliest = max_of(earliest, rs1_ready);
+      break;
+
+    default:
+      halted = (op == OP_HALT);
+      break;
+  }
+
+  if (op == OP_MUL) {
+    issue = reserve_fu(mul_fu_slots, earliest, MUL_LATENCY);
+    complete = issue + MUL_LATENCY;
+  }
+  else if (uses_iq) {
+    issue = reserve_fu(int_fu_slots, earliest, 1);
+    complete = issue + 1;
+  }
+
+  if (is_mem) {
+    /* LSQ sends its head to MEM in order, once the address is computed */
+    int mem_start = max_of(complete, model->mem_free);
+    if (op == OP_STORE) {
+      /* STORE leaves ROB when it is at the head and goes to MEM */
+      mem_start = max_of(mem_start, model->last_commit);
+      commit = commit_slot(model, mem_start);
+      mem_start = commit;
+    }
+    else {
+      complete = mem_start + MEM_LATENCY;
+    }
+    model->mem_free = mem_start + MEM_LATENCY;
+    model->lsq_release[model->lsq_count % config->lsq_entries] = mem_start;
+    model->lsq_count++;
+  }
+
+  if (op == OP_HALT) {
+    /* HALT retires once the ROB is drained and MEM is idle */
+    commit = commit_slot(model, max_of(dispatch + 1, model->mem_free + 1));
+    model->cycles = commit;
+  }
+  else if (op != OP_STORE) {
+    commit = commit_slot(model, complete + 1);
+  }
+
+  if (writes_rd) {
+    model->reg_ready[ins->rd] = complete;
+  }
+  if (sets_flag) {
+    model->flag_ready = complete;
+  }
+  if (op == OP_JUMP || op == OP_JAL || taken) {
+    /* Branch resolves in Int_FU and fetch restarts in the following cycle */
+    model->fetch_ready = complete + 1;
+    model->mispredictions++;
+  }
+
+  model->rob_release[model->rob_count % config->rob_entries] = commit;
+  model->rob_is_load[model->rob_count % config->rob_entries] = (op == OP_LOAD);
+  model->rob_count++;
+  if (uses_iq) {
+    model->iq_release[model->iq_count % config->iq_entries] = issue;
+    model->iq_count++;
+  }
+  if (is_branch) {
+    /* Branch tag is released when the branch commits */
+    model->bis_release[model->bis_count % config->bis_entries] = commit;
+    model->bis_count++;
+  }
+
+  if (op != OP_HALT) {
+    model->instructions++;
+  }
+  return halted;
+}
+
+/* Cycles of the run once the last instruction was charged */
+static void
+finish_timing(APEX_CPU* cpu, INTERVAL_MODEL* model, int halted)
+{
+  if (!halted) {
+    model->cycles = model->last_commit;
+  }
+  if (model->cycles > cpu->max_cycles) {
+    model->cycles = cpu->max_cycles;
+  }
+}
+
+/*
+ * Runs the program through the interval model and leaves the
+ * estimate in cpu->interval. CPU state itself is not modified.
+ */
+int
+interval_model_run(APEX_CPU* cpu)
+{
+  INTERVAL_MODEL* model = &cpu->interval;
+  init_interval_model(cpu);
+
+  int pc = 4000;
+  int halted = 0;
+
+  while (!halted) {
+    int index = get_code_index(pc);
+    if (index < 0 || index >= cpu->code_memory_size) {
+      break;
+    }
+    APEX_Instruction* ins = &cpu->code_memory[index];
+    int next_pc = functional_step(&model->state, ins, pc);
+    halted = time_instruction(cpu, model, ins, model->state.taken);
+    if (halted < 0) {
+      halted = 0;
+      break;
+    }
+    pc = next_pc;
+  }
+  finish_timing(cpu, model, halted);
+
+  /* Stores of the model only matter while it runs */
+  free_data_memory(&model->memory);
+  return 0;
+}
+
+/*
+ * Runs the interval model over a commit trace of the program instead of
+ * executing it, once for each configuration. The trace is mapped once and
+ * shared by the runs, records are decoded straight from the mapping.
+ * Instructions are looked up in code memory by the PC of their record.
+ */
+int
+replay_trace_run(APEX_CPU* cpu, const char* filename, MODEL_CONFIG* configs, int configs_number)
+{
+  long size;
+  const unsigned char* trace = map_commit_trace(filename, &size);
+  if (!trace) {
+    return -1;
+  }
+
+  printf("\n================================= TRACE REPLAY =================================\n");
+  printf("|\tROB\t|\tIQ\t|\tLSQ\t|\tBIS\t|\tCycles\t|\tIPC\t|\n");
+
+  int status = 0;
+  for (int i = 0; i < configs_number && !status; i++) {
+    INTERVAL_MODEL* model = &cpu->interval;
+    TRACE_READER reader;
+    TRACE_RECORD record;
+    int halted = 0;
+    init_timing(model, &configs[i]);
+    init_trace_reader(&reader, trace, size);
+
+    while (!halted && read_trace_record(&reader, &record) > 0) {
+      int index = get_code_index(record.pc);
+      if (index < 0 || index >= cpu->code_memory_size ||
+          cpu->code_memory[index].opcode_id != record.opcode_id) {
+        fprintf(stderr, "APEX_Error : Trace %s does not match the program at PC %d\n",
+                filename, record.pc);
+        status = -1;
+        break;
+      }
+      halted = time_instruction(cpu, model, &cpu->code_memory[index], record.taken);
+      if (halted < 0) {
+        halted = 0;
+        break;
+      }
+    }
+    if (reader.offset > reader.size) {
+      fprintf(stderr, "APEX_Error : Trace %s is truncated\n", filename);
+      status = -1;
+    }
+    if (status) {
+      break;
+    }
+    finish_timing(cpu, model, halted);
+
+    printf("|\t%d\t|\t%d\t|\t%d\t|\t%d\t|\t%d\t|\t%.3f\t|\n",
+           model->config.rob_entries, model->config.iq_entries, model->config.lsq_entries,
+           model->config.bis_entries, model->cycles,
+           model->cycles ? (double)model->instructions / model->cycles : 0.0);
+  }
+  printf("================================================================================\n");
+
+  unmap_commit_trace(trace, size);
+  return status;
+}
+
+void
+display_interval_model(APEX_CPU* cpu)
+{
+  INTERVAL_MODEL* model = &cpu->interval;
+  int drain = model->cycles - model->base_cycles - model->branch_penalty - model->load_penalty -
+              model->rob_penalty - model->iq_penalty - model->lsq_penalty - model->bis_penalty;
+
+  printf("\n================================ INTERVAL MODEL ================================\n");
+  printf("         |\tInstructions\t\t|\t%d\t|\n", model->instructions);
+  printf("         |\tCycles\t\t\t|\t%d\t|\n", model->cycles);
+  printf("         |\tIPC\t\t\t|\t%.3f\t|\n",
+         model->cycles ? (double)model->instructions / model->cycles : 0.0);
+  printf("         |\tBase dispatch cycles\t|\t%d\t|\n", model->base_cycles);
+  printf("         |\tBranch mispredictions\t|\t%d\t|\n", model->branch_penalty);
+  printf("         |\tLong-latency loads\t|\t%d\t|\n", model->load_penalty);
+  printf("         |\tROB full\t\t|\t%d\t|\n", model->rob_penalty);
+  printf("         |\tIQ full\t\t\t|\t%d\t|\n", model->iq_penalty);
+  printf("         |\tLSQ full\t\t|\t%d\t|\n", model->lsq_penalty);
+  printf("         |\tBIS full\t\t|\t%d\t|\n", model->bis_penalty);
+  printf("         |\tFill and drain\t\t|\t%d\t|\n", drain);
+  printf("         |\tMispredicted branches\t|\t%d\t|\n", model->mispredictions);
+  printf("================================================================================\n");
+}
+
+/*
+ * Prints the interval model estimate next to the result of the detailed
+ * pipeline. Must be called after APEX_cpu_run.
+ */
+void
+compare_interval_model(APEX_CPU* cpu, double interval_time, double detailed_time)
+{
+  INTERVAL_MODEL* model = &cpu->interval;
+  int cycles = cpu->clock - 1;
+  double ipc = cycles ? (double)cpu->instructions_committed / cycles : 0.0;
+  double estimate = model->cycles ? (double)model->instructions / model->cycles : 0.0;
+
+  printf("\n============================ INTERVAL MODEL VALIDATION =========================\n");
+  printf("         |\t\t\t|\tInterval\t|\tDetailed\t|\n");
+  printf("         |\tInstructions\t|\t%d\t\t|\t%d\t\t|\n", model->instructions, cpu->instructions_committed);
+  printf("         |\tCycles\t\t|\t%d\t\t|\t%d\t\t|\n", model->cycles, cycles);
+  printf("         |\tIPC\t\t|\t%.3f\t\t|\t%.3f\t\t|\n", estimate, ipc);
+  printf("         |\tHost time (ms)\t|\t%.3f\t\t|\t%.3f\t\t|\n", interval_time * 1000, detailed_time * 1000);
+  printf("         |\tIPC error\t|\t%.2f%%\n", ipc ? (estimate - ipc) * 100 / ipc : 0.0);
+  printf("================================================================================\n");
+}
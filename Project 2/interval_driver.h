@@ -0,0 +1,25 @@
+/*
+ *  interval_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+int
+interval_model_run(APEX_CPU* cpu);
+
+void
+display_interval_model(APEX_CPU* cpu);
+
+void
+compare_interval_model(APEX_CPU* cpu, double interval_time, double detailed_time);
+
+void
+default_model_config(MODEL_CONFIG* config);
+
+int
+parse_model_config(const char* argument, MODEL_CONFIG* config);
+
+int
+replay_trace_run(APEX_CPU* cpu, const char* filename, MODEL_CONFIG* configs, int configs_number);
@@ -12,6 +12,7 @@
 
 #include "cpu.h"
 #include "iq_driver.h"
+#include "scheduler_driver.h"
 
 int
 is_iq_entry_free(APEX_CPU* cpu)
@@ -50,6 +51,8 @@ push_iq_entry(APEX_CPU* cpu, ISSUE_QUEUE_Entry* new_iq_entry)
   cpu->iq.iq_entry[free_entry].LSQ_index  = new_iq_entry->LSQ_index;
   cpu->iq.iq_entry[free_entry].rob_entry_id  = new_iq_entry->rob_entry_id;
   cpu->iq.iq_entry[free_entry].branch_id  = new_iq_entry->branch_id;
+  cpu->iq.iq_entry[free_entry].dispatch_clock = cpu->clock;
+  schedule_event(cpu, EV_ISSUE, 1);
   return 0;
 }
 
@@ -65,6 +68,9 @@ get_instruction_for_FUs(APEX_CPU* cpu, enum STAGES FU_Type)
     int issue_instruction_index = -1;
     int max_counter = 0;
     for (int i = 0; i < IQ_ENTRIES_NUMBER; i++) {
+      if (!cpu->iq.iq_entry[i].free) {
+        cpu->iq.iq_entry[i].counter = cpu->clock - cpu->iq.iq_entry[i].dispatch_clock;
+      }
 
       if (!cpu->iq.iq_entry[i].free &&
           cpu->iq.iq_entry[i].FU_type == FU_Type &&
@@ -107,21 +113,29 @@ get_instruction_for_FUs(APEX_CPU* cpu, enum STAGES FU_Type)
       cpu->stage[FU_Type].LSQ_index = cpu->iq.iq_entry[issue_instruction_index].LSQ_index;
       cpu->stage[FU_Type].busy = 0;
       cpu->stage[FU_Type].stalled = 0;
+      cpu->rob.rob_entry[cpu->stage[FU_Type].rob_entry_id].issue_clock = cpu->clock;
 
       // Clearing IQ entry
       cpu->iq.iq_entry[issue_instruction_index].free = 1;
+
+      schedule_event(cpu, FU_Type == Mul_FU ? EV_EXECUTE_MUL : EV_EXECUTE_INT, 1);
+      schedule_event(cpu, EV_DECODE, 0);
     }
   }
 
   return 0;
 }
 
+/*
+ * Counters are derived from the dispatch clock, so they stay right
+ * in cycles in which IQ is not evaluated
+ */
 int
 update_counters(APEX_CPU* cpu)
 {
   for (int i = 0; i < IQ_ENTRIES_NUMBER; i++) {
     if (!cpu->iq.iq_entry[i].free) {
-      cpu->iq.iq_entry[i].counter++;
+      cpu->iq.iq_entry[i].counter = cpu->clock - cpu->iq.iq_entry[i].dispatch_clock + 1;
     }
   }
   return 0;
@@ -130,6 +144,7 @@ update_counters(APEX_CPU* cpu)
 int
 broadcast_result_into_iq(APEX_CPU* cpu, enum STAGES FU_type)
 {
+  schedule_event(cpu, EV_ISSUE, 0);
   for (int i = 0; i < IQ_ENTRIES_NUMBER; i++) {
     if (!cpu->iq.iq_entry[i].free) {
       if (cpu->iq.iq_entry[i].phys_rs1 == cpu->stage[FU_type].phys_rd) {
@@ -164,6 +179,24 @@ print_iq_for_debug(APEX_CPU* cpu)
   }
 }
 
+/* Prints the entry as a row of display_iq, without the line end */
+void
+print_iq_entry(APEX_CPU* cpu, int i)
+{
+  CPU_Stage instruction_to_print;
+  printf("| Counter = %d |\tpc(%d)  ", cpu->iq.iq_entry[i].counter, cpu->iq.iq_entry[i].pc);
+  strcpy(instruction_to_print.opcode, cpu->iq.iq_entry[i].opcode);
+  instruction_to_print.arch_rs1 = cpu->iq.iq_entry[i].arch_rs1;
+  instruction_to_print.phys_rs1 = cpu->iq.iq_entry[i].phys_rs1;
+  instruction_to_print.arch_rs2 = cpu->iq.iq_entry[i].arch_rs2;
+  instruction_to_print.phys_rs2 = cpu->iq.iq_entry[i].phys_rs2;
+  instruction_to_print.arch_rd = cpu->iq.iq_entry[i].arch_rd;
+  instruction_to_print.phys_rd = cpu->iq.iq_entry[i].phys_rd;
+  instruction_to_print.imm = cpu->iq.iq_entry[i].imm;
+  print_instruction(0, &instruction_to_print);
+  printf("\t|");
+}
+
 void
 display_iq(APEX_CPU* cpu)
 {
@@ -172,18 +205,8 @@ display_iq(APEX_CPU* cpu)
   for (int i = 0; i < IQ_ENTRIES_NUMBER; i++) {
     if (!cpu->iq.iq_entry[i].free) {
       iq_empty = 0;
-      printf("| Counter = %d |\tpc(%d)  ", cpu->iq.iq_entry[i].counter, cpu->iq.iq_entry[i].pc);
-      CPU_Stage* instruction_to_print = malloc(sizeof(*instruction_to_print));
-      strcpy(instruction_to_print->opcode, cpu->iq.iq_entry[i].opcode);
-      instruction_to_print->arch_rs1 = cpu->iq.iq_entry[i].arch_rs1;
-      instruction_to_print->phys_rs1 = cpu->iq.iq_entry[i].phys_rs1;
-      instruction_to_print->arch_rs2 = cpu->iq.iq_entry[i].arch_rs2;
-      instruction_to_print->phys_rs2 = cpu->iq.iq_entry[i].phys_rs2;
-      instruction_to_print->arch_rd = cpu->iq.iq_entry[i].arch_rd;
-      instruction_to_print->phys_rd = cpu->iq.iq_entry[i].phys_rd;
-      instruction_to_print->imm = cpu->iq.iq_entry[i].imm;
-      print_instruction(0, instruction_to_print);
-      printf("\t|\n");
+      print_iq_entry(cpu, i);
+      printf("\n");
     }
   }
   if (iq_empty) {
@@ -233,5 +256,15 @@ process_iq(APEX_CPU* cpu)
   get_instruction_for_FUs(cpu, Int_FU);
   get_instruction_for_FUs(cpu, Mul_FU);
   update_counters(cpu);
+
+  /* Instructions left with ready operands compete again in the next cycle */
+  for (int i = 0; i < IQ_ENTRIES_NUMBER; i++) {
+    if (!cpu->iq.iq_entry[i].free &&
+        cpu->iq.iq_entry[i].rs1_ready &&
+        cpu->iq.iq_entry[i].rs2_ready) {
+      schedule_event(cpu, EV_ISSUE, 1);
+      break;
+    }
+  }
   return 0;
 }
@@ -27,5 +27,8 @@ flush_iq(APEX_CPU* cpu, int branch_id);
 int
 process_iq(APEX_CPU* cpu);
 
+void
+print_iq_entry(APEX_CPU* cpu, int i);
+
 void
 display_iq(APEX_CPU* cpu);
@@ -0,0 +1,194 @@
+/*
+ *  latency_driver.c
+ *  Lifecycle latency histograms of committed instructions
+ *
+ *  Every instruction carries the clock of its fetch, dispatch, issue from the
+ *  IQ, issue from the LSQ to MEM (LOAD only), and completion in its ROB entry.
+ *  When it leaves the ROB the spans between them are added to the histograms
+ *  of its opcode class. Flushed instructions never commit and are not counted.
+ *
+ *  STORE leaves the ROB when the LSQ sends it to MEM and is never marked
+ *  complete, so only its fetch, dispatch and issue spans are known. HALT is
+ *  complete at dispatch and never issued.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "latency_driver.h"
+
+static const char* class_names[NUM_LAT_CLASSES] = {"ALU", "MUL", "LOAD", "STORE", "Branch", "Other"};
+static const char* span_names[NUM_LAT_SPANS] = {
+  "Fetch-Dispatch", "Dispatch-Issue", "Issue-Memory", "Issue-Complete", "Complete-Commit", "Fetch-Commit"
+};
+
+void
+init_latency(APEX_CPU* cpu)
+{
+  memset(&cpu->latency, 0, sizeof(cpu->latency));
+}
+
+static int
+get_latency_class(const char* opcode)
+{
+  switch (get_opcode_id(opcode)) {
+    case OP_MOVC:
+    case OP_ADD:
+    case OP_SUB:
+    case OP_AND:
+    case OP_OR:
+    case OP_EXOR:
+    case OP_ADDL:
+    case OP_SUBL:
+      return LAT_ALU;
+    case OP_MUL:
+      return LAT_MUL;
+    case OP_LOAD:
+      return LAT_LOAD;
+    case OP_STORE:
+      return LAT_STORE;
+    case OP_BZ:
+    case OP_BNZ:
+    case OP_JUMP:
+    case OP_JAL:
+      return LAT_BRANCH;
+    default:
+      return LAT_OTHER;
+  }
+}
+
+static void
+add_span(LATENCY* latency, int class, enum LATENCY_SPANS span, int start, int end)
+{
+  if (start < 0 || end < start) {
+    return;
+  }
+  int cycles = end - start;
+  latency->counts[class][span][cycles < LATENCY_BINS ? cycles : LATENCY_BINS - 1]++;
+  latency->sums[class][span] += cycles;
+  if (cycles > latency->max[class][span]) {
+    latency->max[class][span] = cycles;
+  }
+}
+
+/* Called as the instruction leaves the ROB */
+void
+record_latency(APEX_CPU* cpu, ROB_Entry* entry)
+{
+  LATENCY* latency = &cpu->latency;
+  int class = get_latency_class(entry->opcode);
+  add_span(latency, class, SPAN_FETCH_DISPATCH, entry->fetch_clock, entry->dispatch_clock);
+  add_span(latency, class, SPAN_DISPATCH_ISSUE, entry->dispatch_clock, entry->issue_clock);
+  add_span(latency, class, SPAN_ISSUE_MEMORY, entry->issue_clock, entry->memory_clock);
+  add_span(latency, class, SPAN_ISSUE_COMPLETE, entry->issue_clock, entry->complete_clock);
+  add_span(latency, class, SPAN_COMPLETE_COMMIT, entry->complete_clock, cpu->clock);
+  add_span(latency, class, SPAN_FETCH_COMMIT, entry->fetch_clock, cpu->clock);
+}
+
+/* Called at every loop head, so the histograms of the last iteration are known */
+void
+mark_loop_latency(APEX_CPU* cpu)
+{
+  LATENCY* latency = &cpu->latency;
+  for (int c = 0; c < NUM_LAT_CLASSES; c++) {
+    for (int s = 0; s < NUM_LAT_SPANS; s++) {
+      for (int n = 0; n < LATENCY_BINS; n++) {
+        latency->loop_period[c][s][n] = latency->counts[c][s][n] - latency->loop_mark[c][s][n];
+        latency->loop_mark[c][s][n] = latency->counts[c][s][n];
+      }
+      latency->sums_period[c][s] = latency->sums[c][s] - latency->sums_mark[c][s];
+      latency->sums_mark[c][s] = latency->sums[c][s];
+    }
+  }
+}
+
+/* Adds iterations skipped by the loop fast-forward like the last detailed one */
+void
+skip_loop_latency(APEX_CPU* cpu, int iterations)
+{
+  LATENCY* latency = &cpu->latency;
+  for (int c = 0; c < NUM_LAT_CLASSES; c++) {
+    for (int s = 0; s < NUM_LAT_SPANS; s++) {
+      for (int n = 0; n < LATENCY_BINS; n++) {
+        latency->counts[c][s][n] += latency->loop_period[c][s][n] * iterations;
+      }
+      latency->sums[c][s] += latency->sums_period[c][s] * iterations;
+    }
+  }
+}
+
+/* Returns the smallest latency at or below which the given share of instructions was */
+static int
+percentile(long* counts, long total, double share)
+{
+  long sum = 0;
+  for (int n = 0; n < LATENCY_BINS; n++) {
+    sum += counts[n];
+    if (sum >= share * total) {
+      return n;
+    }
+  }
+  return LATENCY_BINS - 1;
+}
+
+/* Latencies in the last bin are only known to be at least that long */
+static const char*
+format_bin(char* buffer, int size, int bin)
+{
+  snprintf(buffer, size, bin == LATENCY_BINS - 1 ? "%d+" : "%d", bin);
+  return buffer;
+}
+
+void
+display_latency_stats(APEX_CPU* cpu)
+{
+  LATENCY* latency = &cpu->latency;
+  char p50[16], p90[16], p99[16];
+
+  printf("\n=================================== LATENCY ====================================\n");
+  for (int s = 0; s < NUM_LAT_SPANS; s++) {
+    printf("         |\t%s\t|\tCount\t|\tMean\t|\tp50\t|\tp90\t|\tp99\t|\tMax\t|\n", span_names[s]);
+    for (int c = 0; c < NUM_LAT_CLASSES; c++) {
+      long* counts = latency->counts[c][s];
+      long total = 0;
+      for (int n = 0; n < LATENCY_BINS; n++) {
+        total += counts[n];
+      }
+      if (!total) {
+        continue;
+      }
+      printf("         |\t%s\t\t|\t%ld\t|\t%.2f\t|\t%s\t|\t%s\t|\t%s\t|\t%d\t|\n",
+             class_names[c], total, (double)latency->sums[c][s] / total,
+             format_bin(p50, sizeof(p50), percentile(counts, total, 0.5)),
+             format_bin(p90, sizeof(p90), percentile(counts, total, 0.9)),
+             format_bin(p99, sizeof(p99), percentile(counts, total, 0.99)),
+             latency->max[c][s]);
+    }
+  }
+
+  if (latency->histograms) {
+    char bin[16];
+    for (int s = 0; s < NUM_LAT_SPANS; s++) {
+      for (int c = 0; c < NUM_LAT_CLASSES; c++) {
+        long* counts = latency->counts[c][s];
+        int printed = 0;
+        for (int n = 0; n < LATENCY_BINS; n++) {
+          if (!counts[n]) {
+            continue;
+          }
+          if (!printed++) {
+            printf("         |\t%s %s cycles\t|\tInstructions\t|\n", class_names[c], span_names[s]);
+          }
+          printf("         |\t%s\t\t|\t%ld\t|\n", format_bin(bin, sizeof(bin), n), counts[n]);
+        }
+      }
+    }
+  }
+  printf("================================================================================\n");
+}
@@ -0,0 +1,22 @@
+/*
+ *  latency_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+void
+init_latency(APEX_CPU* cpu);
+
+void
+record_latency(APEX_CPU* cpu, ROB_Entry* entry);
+
+void
+mark_loop_latency(APEX_CPU* cpu);
+
+void
+skip_loop_latency(APEX_CPU* cpu, int iterations);
+
+void
+display_latency_stats(APEX_CPU* cpu);
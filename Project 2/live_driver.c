@@ -0,0 +1,100 @@
+/*
+ *  live_driver.c
+ *  Running counters published in POSIX shared memory
+ *
+ *  With --live-stats <name> the simulator creates the shared memory object
+ *  /<name> holding a LIVE_STATS page and updates its counters every
+ *  LIVE_UPDATE_CYCLES simulated cycles, and once more when the run stops.
+ *  apex_monitor maps the page read-only and prints the progress of the run.
+ *
+ *  Counters are written and read with relaxed atomics. They are independent
+ *  totals, so a reader may see one update of a counter and the previous one
+ *  of another, but never a torn value, and the simulator never waits for a
+ *  reader. The object is removed when the simulator stops; a monitor that is
+ *  still attached keeps the page and sees the run finished.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "cpu.h"
+#include "live_driver.h"
+#include "occupancy_driver.h"
+
+int
+open_live_stats(APEX_CPU* cpu, const char* name, const char* program)
+{
+  LIVE_PAGE* live = &cpu->live;
+  snprintf(live->name, sizeof(live->name), "%s%s", name[0] == '/' ? "" : "/", name);
+
+  int fd = shm_open(live->name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, sizeof(LIVE_STATS)) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to create shared memory %s\n", live->name);
+    if (fd >= 0) {
+      close(fd);
+      shm_unlink(live->name);
+    }
+    return -1;
+  }
+  void* page = mmap(NULL, sizeof(LIVE_STATS), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (page == MAP_FAILED) {
+    fprintf(stderr, "APEX_Error : Unable to map shared memory %s\n", live->name);
+    shm_unlink(live->name);
+    return -1;
+  }
+
+  LIVE_STATS* stats = page;
+  stats->version = LIVE_VERSION;
+  stats->pid = getpid();
+  snprintf(stats->program, sizeof(stats->program), "%s", program);
+  atomic_store_explicit(&stats->state, LIVE_RUNNING, memory_order_relaxed);
+  live->stats = stats;
+  live->next_clock = 0;
+  publish_live_stats(cpu);
+
+  /* The magic goes last, so a monitor never attaches to a page being filled */
+  atomic_thread_fence(memory_order_release);
+  memcpy(stats->magic, LIVE_MAGIC, sizeof(stats->magic));
+  return 0;
+}
+
+/* Publishes the counters of the end of the run and removes the object */
+void
+close_live_stats(APEX_CPU* cpu)
+{
+  LIVE_PAGE* live = &cpu->live;
+  if (!live->stats) {
+    return;
+  }
+  publish_live_stats(cpu);
+  atomic_store_explicit(&live->stats->state, LIVE_FINISHED, memory_order_relaxed);
+  munmap(live->stats, sizeof(LIVE_STATS));
+  shm_unlink(live->name);
+  live->stats = NULL;
+}
+
+/* Called between cycles once the clock reaches next_clock */
+void
+publish_live_stats(APEX_CPU* cpu)
+{
+  LIVE_STATS* stats = cpu->live.stats;
+  atomic_store_explicit(&stats->max_cycles, cpu->max_cycles, memory_order_relaxed);
+  atomic_store_explicit(&stats->clock, cpu->clock, memory_order_relaxed);
+  atomic_store_explicit(&stats->committed, cpu->instructions_committed, memory_order_relaxed);
+  atomic_store_explicit(&stats->flushes, cpu->flushes, memory_order_relaxed);
+  for (int s = 0; s < NUM_OCC_QUEUES; s++) {
+    atomic_store_explicit(&stats->occupancy[s], occupancy_entry_cycles(cpu, occupancy_queues[s]),
+                          memory_order_relaxed);
+  }
+  atomic_fetch_add_explicit(&stats->updates, 1, memory_order_relaxed);
+  cpu->live.next_clock = cpu->clock + LIVE_UPDATE_CYCLES;
+}
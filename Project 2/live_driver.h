@@ -0,0 +1,44 @@
+/*
+ *  live_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdatomic.h>
+
+#define LIVE_MAGIC "APEXLIVE"
+#define LIVE_VERSION 1
+#define LIVE_UPDATE_CYCLES 4096
+
+enum LIVE_STATES
+{
+  LIVE_RUNNING,
+  LIVE_FINISHED
+};
+
+/* Page of running counters shared with apex_monitor */
+typedef struct LIVE_STATS
+{
+  char magic[8];
+  int version;
+  int pid;    // simulator process
+  char program[256];
+  _Atomic int state;    // LIVE_STATES
+  _Atomic long updates;
+  _Atomic long max_cycles;
+  _Atomic long clock;
+  _Atomic long committed;
+  _Atomic long flushes;
+  _Atomic long occupancy[NUM_OCC_QUEUES];    // entry cycles of occupancy_queues, see occupancy_entry_cycles
+} LIVE_STATS;
+
+int
+open_live_stats(APEX_CPU* cpu, const char* name, const char* program);
+
+void
+close_live_stats(APEX_CPU* cpu);
+
+void
+publish_live_stats(APEX_CPU* cpu);
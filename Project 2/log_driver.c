@@ -0,0 +1,75 @@
+/*
+ *  log_driver.c
+ *  Trace messages of the pipeline
+ *
+ *  TRACE calls sit in the hot paths of the pipeline, so they are removed by
+ *  the compiler unless the build asks for them with TRACE_LEVEL and
+ *  TRACE_CATEGORIES (see log_driver.h). Messages that are compiled in are
+ *  formatted into a per-CPU buffer and written to stderr in large pieces,
+ *  keeping stdout to the stage and stats displays.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "cpu.h"
+#include "log_driver.h"
+
+#define TRACE_LOG_SIZE (1 << 16)
+#define TRACE_MESSAGE_SIZE 256
+
+typedef struct TRACE_LOG
+{
+  char buffer[TRACE_LOG_SIZE];
+  int fill;
+} TRACE_LOG;
+
+/* Appends a message, prefixed by the clock cycle, to the trace log of the CPU */
+void
+trace_message(APEX_CPU* cpu, const char* format, ...)
+{
+  if (!cpu->log) {
+    cpu->log = calloc(1, sizeof(TRACE_LOG));
+    if (!cpu->log) {
+      return;
+    }
+  }
+  TRACE_LOG* log = cpu->log;
+  if (log->fill + TRACE_MESSAGE_SIZE > TRACE_LOG_SIZE) {
+    flush_trace_log(cpu);
+  }
+
+  char* out = log->buffer + log->fill;
+  va_list args;
+  va_start(args, format);
+  int length = snprintf(out, TRACE_MESSAGE_SIZE, "%6d ", cpu->clock);
+  length += vsnprintf(out + length, TRACE_MESSAGE_SIZE - length, format, args);
+  va_end(args);
+  if (length > TRACE_MESSAGE_SIZE - 1) {
+    length = TRACE_MESSAGE_SIZE - 1;
+  }
+  out[length] = '\n';
+  log->fill += length + 1;
+}
+
+void
+flush_trace_log(APEX_CPU* cpu)
+{
+  if (cpu->log && cpu->log->fill) {
+    fwrite(cpu->log->buffer, 1, cpu->log->fill, stderr);
+    cpu->log->fill = 0;
+  }
+}
+
+void
+free_trace_log(APEX_CPU* cpu)
+{
+  flush_trace_log(cpu);
+  free(cpu->log);
+  cpu->log = NULL;
+}
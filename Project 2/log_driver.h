@@ -0,0 +1,39 @@
+/*
+ *  log_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+/* Compile-time trace level and categories, e.g. make TRACE_LEVEL=2.
+ * With level 0 every TRACE compiles to nothing.
+ */
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL 0
+#endif
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES 0xff
+#endif
+
+#define TRACE_FETCH 0x01
+#define TRACE_DECODE 0x02
+#define TRACE_EXECUTE 0x04
+#define TRACE_MEMORY 0x08
+#define TRACE_COMMIT 0x10
+
+#define TRACE(cpu, category, level, ...) \
+  do { \
+    if (TRACE_LEVEL >= (level) && (TRACE_CATEGORIES & (category))) { \
+      trace_message((cpu), __VA_ARGS__); \
+    } \
+  } while (0)
+
+void
+trace_message(APEX_CPU* cpu, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+void
+flush_trace_log(APEX_CPU* cpu);
+
+void
+free_trace_log(APEX_CPU* cpu);
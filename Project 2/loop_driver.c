@@ -0,0 +1,352 @@
+/*
+ *  loop_driver.c
+ *  Steady-state loop detection and fast-forwarding
+ *
+ *  Every time fetch is about to fetch the head of the current loop (target of
+ *  the last taken backward branch), the occupancy pattern of IQ, ROB, LSQ and
+ *  the stage latches is recorded, without register values. When the same
+ *  pattern repeats with the same number of cycles and committed instructions
+ *  in between, the pipeline is drained and whole iterations are executed
+ *  functionally, charging the measured cycles of one iteration for each of them.
+ *  Fast-forwarding stops before the first iteration that takes a different path.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "loop_driver.h"
+#include "stall_driver.h"
+#include "occupancy_driver.h"
+#include "latency_driver.h"
+#include "topdown_driver.h"
+#include "profile_driver.h"
+#include "callstack_driver.h"
+#include "rob_driver.h"
+#include "lsq_driver.h"
+#include "functional_driver.h"
+#include "memory_driver.h"
+#include "device_driver.h"
+#include "trace_driver.h"
+
+/* Number of iterations with the same pipeline state before fast-forwarding */
+#define LOOP_MATCHES_NEEDED 2
+
+void
+init_loop_detector(APEX_CPU* cpu)
+{
+  memset(&cpu->loop, 0, sizeof(cpu->loop));
+  cpu->loop.head_pc = -1;
+}
+
+/*
+ * Called on every taken branch. A backward branch makes its target
+ * the loop head to watch.
+ */
+void
+note_branch_target(APEX_CPU* cpu, int branch_pc, int target)
+{
+  if (!cpu->loop.enabled || target >= branch_pc || target == cpu->loop.head_pc) {
+    return;
+  }
+  cpu->loop.head_pc = target;
+  cpu->loop.signature_length = 0;
+  cpu->loop.matches = 0;
+}
+
+static int
+build_signature(APEX_CPU* cpu, int* signature)
+{
+  int length = 0;
+
+  for (enum STAGES stage = F; stage < NUM_STAGES; stage++) {
+    signature[length++] = strcmp(cpu->stage[stage].opcode, "") == 0 ? -1 : cpu->stage[stage].pc;
+    signature[length++] = cpu->stage[stage].stalled;
+    signature[length++] = cpu->stage[stage].busy;
+  }
+  signature[length++] = cpu->mul_cycle;
+  signature[length++] = cpu->stage[MEM].stalled ? cpu->mem_done_clock - cpu->clock : 0;
+  signature[length++] = cpu->commitments;
+
+  int free_regs = 0;
+  for (int i = 0; i < URF_ENTRIES_NUMBER; i++) {
+    free_regs += cpu->urf[i].free;
+  }
+  signature[length++] = free_regs;
+
+  /* ROB and LSQ from head to tail, so that the position in the ring does not matter */
+  int rob_count = 0;
+  for (int i = cpu->rob.head; !cpu->rob.rob_entry[i].free && rob_count < ROB_ENTRIES_NUMBER;
+       i = (i + 1) % ROB_ENTRIES_NUMBER) {
+    signature[length++] = cpu->rob.rob_entry[i].pc;
+    signature[length++] = cpu->rob.rob_entry[i].status;
+    rob_count++;
+  }
+  signature[length++] = rob_count;
+
+  int lsq_count = 0;
+  for (int i = cpu->lsq.head; !cpu->lsq.lsq_entry[i].free && lsq_count < LSQ_ENTRIES_NUMBER;
+       i = (i + 1) % LSQ_ENTRIES_NUMBER) {
+    signature[length++] = cpu->lsq.lsq_entry[i].pc;
+    signature[length++] = cpu->lsq.lsq_entry[i].mem_address_valid;
+    signature[length++] = cpu->lsq.lsq_entry[i].rs1_ready;
+    lsq_count++;
+  }
+  signature[length++] = lsq_count;
+
+  for (int i = 0; i < IQ_ENTRIES_NUMBER; i++) {
+    ISSUE_QUEUE_Entry* entry = &cpu->iq.iq_entry[i];
+    if (entry->free) {
+      signature[length++] = -1;
+      continue;
+    }
+    signature[length++] = entry->pc;
+    signature[length++] = cpu->clock - entry->dispatch_clock;
+    signature[length++] = entry->rs1_ready;
+    signature[length++] = entry->rs2_ready;
+    if (strcmp(entry->opcode, "BZ") == 0 || strcmp(entry->opcode, "BNZ") == 0) {
+      signature[length++] = cpu->urf[cpu->bis.bis_entry[entry->branch_id].phys_src].valid;
+    }
+  }
+
+  return length;
+}
+
+static int
+is_pipeline_empty(APEX_CPU* cpu)
+{
+  return is_rob_empty(cpu) && is_lsq_empty(cpu) &&
+         strcmp(cpu->stage[DRF].opcode, "") == 0 &&
+         strcmp(cpu->stage[Int_FU].opcode, "") == 0 &&
+         strcmp(cpu->stage[Mul_FU].opcode, "") == 0 &&
+         strcmp(cpu->stage[MEM].opcode, "") == 0;
+}
+
+static int
+writes_register(int opcode_id)
+{
+  return opcode_id != OP_STORE && opcode_id != OP_BZ && opcode_id != OP_BNZ &&
+         opcode_id != OP_JUMP && opcode_id != OP_HALT;
+}
+
+/*
+ * Executes one iteration of the loop functionally. Returns 0 and undoes
+ * it if it does not follow the path of the reference iteration.
+ */
+static int
+run_iteration(APEX_CPU* cpu, FUNCTIONAL_STATE* state, int* reference, int first)
+{
+  LOOP_DETECTOR* loop = &cpu->loop;
+  FUNCTIONAL_STATE saved = *state;
+  int undo_address[LOOP_BODY_SIZE];
+  int undo_value[LOOP_BODY_SIZE];
+  TRACE_RECORD records[LOOP_BODY_SIZE];
+  int stores = 0;
+  int count = 0;
+  int pc = loop->head_pc;
+  int ok = 1;
+
+  do {
+    int index = get_code_index(pc);
+    if (count == LOOP_BODY_SIZE || index < 0 || index >= cpu->code_memory_size) {
+      ok = 0;
+      break;
+    }
+    APEX_Instruction* ins = &cpu->code_memory[index];
+    if (ins->opcode_id == OP_HALT || ins->opcode_id == OP_UNKNOWN ||
+        (writes_register(ins->opcode_id) && cpu->rrat[ins->rd].commited_phys_reg == -1)) {
+      ok = 0;
+      break;
+    }
+    if (first) {
+      reference[count] = pc;
+    }
+    else if (reference[count] != pc) {
+      ok = 0;
+      break;
+    }
+
+    pc = functional_step(state, ins, pc);
+    if ((ins->opcode_id == OP_LOAD || ins->opcode_id == OP_STORE) && is_device_address(state->mem_address)) {
+      /* Device accesses are left to the pipeline */
+      ok = 0;
+      break;
+    }
+    if (cpu->trace.writer) {
+      records[count].pc = reference[count];
+      records[count].opcode_id = ins->opcode_id;
+      records[count].has_value = writes_register(ins->opcode_id);
+      records[count].value = state->regs[ins->rd];
+      records[count].address = state->mem_address;
+      records[count].taken = state->taken;
+    }
+    if (ins->opcode_id == OP_STORE) {
+      undo_address[stores] = state->mem_address;
+      undo_value[stores] = state->mem_old_value;
+      stores++;
+    }
+    count++;
+  } while (pc != loop->head_pc);
+
+  if (ok && (count != loop->period_instructions || state->flag_reg == -1)) {
+    ok = 0;
+  }
+
+  if (ok && cpu->trace.writer) {
+    /* Skipped iterations commit as well */
+    for (int i = 0; i < count; i++) {
+      trace_instruction(&cpu->trace, &records[i]);
+    }
+  }
+
+  if (!ok) {
+    while (stores > 0) {
+      stores--;
+      write_memory(state->memory, undo_address[stores], undo_value[stores]);
+    }
+    *state = saved;
+  }
+  return ok;
+}
+
+static void
+fast_forward_loop(APEX_CPU* cpu)
+{
+  LOOP_DETECTOR* loop = &cpu->loop;
+  FUNCTIONAL_STATE state;
+  int reference[LOOP_BODY_SIZE];
+
+  /* Pipeline is empty, so R-RAT holds the whole architectural state */
+  init_functional_state(&state, &cpu->memory);
+  for (int i = 0; i < RRAT_ENTRIES_NUMBER; i++) {
+    int phys_reg = cpu->rrat[i].commited_phys_reg;
+    state.regs[i] = phys_reg == -1 ? 0 : cpu->urf[phys_reg].value;
+  }
+  if (cpu->last_arith_phys_rd != -1) {
+    state.flag_value = cpu->urf[cpu->last_arith_phys_rd].value;
+  }
+
+  /* Leave at least one iteration worth of cycles to the detailed pipeline */
+  int drain_cycles = cpu->clock - loop->drain_start;
+  int budget = (cpu->max_cycles - cpu->clock) / loop->period_cycles - 1;
+  int iterations = 0;
+  while (iterations < budget && run_iteration(cpu, &state, reference, iterations == 0)) {
+    iterations++;
+  }
+  if (!iterations) {
+    return;
+  }
+
+  for (int i = 0; i < RRAT_ENTRIES_NUMBER; i++) {
+    int phys_reg = cpu->rrat[i].commited_phys_reg;
+    if (phys_reg != -1) {
+      cpu->urf[phys_reg].value = state.regs[i];
+    }
+  }
+  cpu->last_arith_phys_rd = cpu->rrat[state.flag_reg].commited_phys_reg;
+
+  /* Cycles spent on draining overlap with the first skipped iteration */
+  int cycles = iterations * loop->period_cycles - drain_cycles;
+  if (cycles < 0) {
+    cycles = 0;
+  }
+  skip_loop_stalls(cpu, iterations);
+  skip_loop_occupancy(cpu, iterations);
+  skip_loop_latency(cpu, iterations);
+  skip_loop_top_down(cpu, iterations);
+  if (cpu->profile) {
+    skip_loop_profile(cpu, iterations);
+  }
+  if (cpu->call_graph) {
+    skip_loop_call_stacks(cpu, iterations);
+  }
+  cpu->clock += cycles;
+  cpu->instructions_committed += iterations * loop->period_instructions;
+  cpu->flushes += iterations * loop->period_flushes;
+
+  loop->skips++;
+  loop->iterations_skipped += iterations;
+  loop->cycles_skipped += cycles;
+}
+
+/*
+ * Called by fetch when it is about to fetch the loop head.
+ * Returns 1 if fetch has to hold because the pipeline is being drained.
+ */
+int
+loop_head_reached(APEX_CPU* cpu)
+{
+  LOOP_DETECTOR* loop = &cpu->loop;
+
+  if (loop->draining) {
+    if (!is_pipeline_empty(cpu)) {
+      return 1;
+    }
+    fast_forward_loop(cpu);
+    loop->draining = 0;
+    loop->matches = 0;
+    loop->signature_length = 0;
+    return 0;
+  }
+
+  int signature[LOOP_SIGNATURE_SIZE];
+  int length = build_signature(cpu, signature);
+  int period_cycles = cpu->clock - loop->clock;
+  int period_instructions = cpu->instructions_committed - loop->instructions;
+
+  if (length == loop->signature_length &&
+      memcmp(signature, loop->signature, length * sizeof(int)) == 0) {
+    if (loop->matches &&
+        period_cycles == loop->period_cycles &&
+        period_instructions == loop->period_instructions) {
+      loop->matches++;
+    }
+    else {
+      loop->matches = 1;
+      loop->period_cycles = period_cycles;
+      loop->period_instructions = period_instructions;
+    }
+  }
+  else {
+    loop->matches = 0;
+  }
+
+  memcpy(loop->signature, signature, length * sizeof(int));
+  loop->signature_length = length;
+  loop->clock = cpu->clock;
+  loop->instructions = cpu->instructions_committed;
+  loop->period_flushes = cpu->flushes - loop->flushes;
+  loop->flushes = cpu->flushes;
+  mark_loop_stalls(cpu);
+  mark_loop_occupancy(cpu);
+  mark_loop_latency(cpu);
+  mark_loop_top_down(cpu);
+  if (cpu->profile) {
+    mark_loop_profile(cpu);
+  }
+  if (cpu->call_graph) {
+    mark_loop_call_stacks(cpu);
+  }
+
+  if (loop->matches >= LOOP_MATCHES_NEEDED && loop->period_instructions > 0) {
+    loop->draining = 1;
+    loop->drain_start = cpu->clock;
+    return loop_head_reached(cpu);
+  }
+  return 0;
+}
+
+void
+display_loop_stats(APEX_CPU* cpu)
+{
+  printf("\n============================= LOOP FAST-FORWARDING =============================\n");
+  printf("         |\tFast-forwards\t\t|\t%d\t|\n", cpu->loop.skips);
+  printf("         |\tIterations skipped\t|\t%d\t|\n", cpu->loop.iterations_skipped);
+  printf("         |\tCycles skipped\t\t|\t%d\t|\n", cpu->loop.cycles_skipped);
+  printf("================================================================================\n");
+}
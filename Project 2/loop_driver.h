@@ -0,0 +1,19 @@
+/*
+ *  loop_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+void
+init_loop_detector(APEX_CPU* cpu);
+
+void
+note_branch_target(APEX_CPU* cpu, int branch_pc, int target);
+
+int
+loop_head_reached(APEX_CPU* cpu);
+
+void
+display_loop_stats(APEX_CPU* cpu);
@@ -12,6 +12,8 @@
 
 #include "cpu.h"
 #include "rob_driver.h"
+#include "scheduler_driver.h"
+#include "device_driver.h"
 
 
 int
@@ -70,6 +72,10 @@ get_instruction_to_MEM(APEX_CPU* cpu)
         }
       }
     }
+    else if (is_device_address(cpu->lsq.lsq_entry[entry].mem_address)) {
+      /* Popping the input stream can not be undone, so the load must not be flushed */
+      push_to_mem = cpu->rob.head == cpu->lsq.lsq_entry[entry].rob_entry_id;
+    }
     else {
       push_to_mem = 1;
     }
@@ -91,12 +97,19 @@ get_instruction_to_MEM(APEX_CPU* cpu)
     cpu->stage[MEM].branch_id = cpu->lsq.lsq_entry[entry].branch_id;
     cpu->stage[MEM].busy = 0;
     cpu->stage[MEM].stalled = 0;
+    /* STORE has already left the ROB */
+    if (strcmp(cpu->stage[MEM].opcode, "LOAD") == 0) {
+      cpu->rob.rob_entry[cpu->stage[MEM].rob_entry_id].memory_clock = cpu->clock;
+    }
 
     cpu->lsq.lsq_entry[entry].free = 1;
     cpu->lsq.head++;
     if (cpu->lsq.head == LSQ_ENTRIES_NUMBER) {
       cpu->lsq.head = 0;
     }
+
+    schedule_event(cpu, EV_MEMORY, 1);
+    schedule_event(cpu, EV_DECODE, 0);
   }
 }
 
@@ -106,11 +119,13 @@ update_lsq_entry(APEX_CPU* cpu, enum STAGES FU_type)
   int LSQ_index = cpu->stage[FU_type].LSQ_index;
   cpu->lsq.lsq_entry[LSQ_index].mem_address = cpu->stage[FU_type].buffer;
   cpu->lsq.lsq_entry[LSQ_index].mem_address_valid = 1;
+  schedule_event(cpu, EV_LSQ, 0);
 }
 
 void
 broadcast_result_into_lsq(APEX_CPU* cpu, enum STAGES FU_type)
 {
+  schedule_event(cpu, EV_LSQ, 0);
   for (int i = 0; i < LSQ_ENTRIES_NUMBER; i++) {
     if (!cpu->lsq.lsq_entry[i].free &&
         cpu->lsq.lsq_entry[i].phys_rs1 == cpu->stage[FU_type].phys_rd) {
@@ -139,6 +154,24 @@ print_lsq_for_debug(APEX_CPU* cpu)
   printf("Tail: %d, Head: %d\n\n", cpu->lsq.tail, cpu->lsq.head);
 }
 
+/* Prints the instruction of the entry as in display_lsq */
+void
+print_lsq_entry(APEX_CPU* cpu, int i)
+{
+  CPU_Stage instruction_to_print;
+  printf("pc(%d)  ", cpu->lsq.lsq_entry[i].pc);
+  strcpy(instruction_to_print.opcode, cpu->lsq.lsq_entry[i].opcode);
+  instruction_to_print.arch_rs1 = cpu->lsq.lsq_entry[i].arch_rs1;
+  instruction_to_print.phys_rs1 = cpu->lsq.lsq_entry[i].phys_rs1;
+  instruction_to_print.arch_rs2 = cpu->lsq.lsq_entry[i].arch_rs2;
+  instruction_to_print.phys_rs2 = cpu->lsq.lsq_entry[i].phys_rs2;
+  instruction_to_print.arch_rd = cpu->lsq.lsq_entry[i].arch_rd;
+  instruction_to_print.phys_rd = cpu->lsq.lsq_entry[i].phys_rd;
+  instruction_to_print.imm = cpu->lsq.lsq_entry[i].imm;
+  print_instruction(0, &instruction_to_print);
+  printf("\t|");
+}
+
 void
 display_lsq(APEX_CPU* cpu)
 {
@@ -164,18 +197,7 @@ display_lsq(APEX_CPU* cpu)
 
       //printf("\t");
       if (!cpu->lsq.lsq_entry[i].free) {
-      printf("pc(%d)  ", cpu->lsq.lsq_entry[i].pc);
-        CPU_Stage* instruction_to_print = malloc(sizeof(*instruction_to_print));
-        strcpy(instruction_to_print->opcode, cpu->lsq.lsq_entry[i].opcode);
-        instruction_to_print->arch_rs1 = cpu->lsq.lsq_entry[i].arch_rs1;
-        instruction_to_print->phys_rs1 = cpu->lsq.lsq_entry[i].phys_rs1;
-        instruction_to_print->arch_rs2 = cpu->lsq.lsq_entry[i].arch_rs2;
-        instruction_to_print->phys_rs2 = cpu->lsq.lsq_entry[i].phys_rs2;
-        instruction_to_print->arch_rd = cpu->lsq.lsq_entry[i].arch_rd;
-        instruction_to_print->phys_rd = cpu->lsq.lsq_entry[i].phys_rd;
-        instruction_to_print->imm = cpu->lsq.lsq_entry[i].imm;
-        print_instruction(0, instruction_to_print);
-        printf("\t|");
+        print_lsq_entry(cpu, i);
       }
       printf("\n");
     }
@@ -194,6 +216,22 @@ is_lsq_empty(APEX_CPU* cpu)
   return 1;
 }
 
+/* Points the instructions waiting in the IQ and the FUs at the new index of their LSQ entry */
+static void
+move_lsq_index(APEX_CPU* cpu, int from, int to)
+{
+  for (int i = 0; i < IQ_ENTRIES_NUMBER; i++) {
+    if (!cpu->iq.iq_entry[i].free && cpu->iq.iq_entry[i].LSQ_index == from) {
+      cpu->iq.iq_entry[i].LSQ_index = to;
+    }
+  }
+  for (int stage = 0; stage < NUM_STAGES; stage++) {
+    if (strcmp(cpu->stage[stage].opcode, "") != 0 && cpu->stage[stage].LSQ_index == from) {
+      cpu->stage[stage].LSQ_index = to;
+    }
+  }
+}
+
 void
 flush_lsq(APEX_CPU* cpu, int branch_id)
 {
@@ -232,15 +270,22 @@ flush_lsq(APEX_CPU* cpu, int branch_id)
     cpu->lsq.head = 0;
   }
   else {
-    //int previous_branch_id = initial_branch_id--;
-    int new_tail = cpu->lsq.head;
-    while (!cpu->lsq.lsq_entry[new_tail].free) {
-      new_tail++;
-      if (new_tail == LSQ_ENTRIES_NUMBER) {
-        new_tail = 0;
+    /* Entries left may have gaps between them, move them up to the head in program order */
+    int count = 0;
+    for (int i = 0; i < LSQ_ENTRIES_NUMBER; i++) {
+      int from = (cpu->lsq.head + i) % LSQ_ENTRIES_NUMBER;
+      if (cpu->lsq.lsq_entry[from].free) {
+        continue;
+      }
+      int to = (cpu->lsq.head + count) % LSQ_ENTRIES_NUMBER;
+      count++;
+      if (to != from) {
+        cpu->lsq.lsq_entry[to] = cpu->lsq.lsq_entry[from];
+        cpu->lsq.lsq_entry[from].free = 1;
+        move_lsq_index(cpu, from, to);
       }
     }
-    cpu->lsq.tail = new_tail;
+    cpu->lsq.tail = (cpu->lsq.head + count) % LSQ_ENTRIES_NUMBER;
   }
 }
 
@@ -248,4 +293,10 @@ void
 process_lsq(APEX_CPU* cpu)
 {
   get_instruction_to_MEM(cpu);
+
+  /* Head with computed address may be waiting for MEM, ROB head or commit slot */
+  int head = cpu->lsq.head;
+  if (!cpu->lsq.lsq_entry[head].free && cpu->lsq.lsq_entry[head].mem_address_valid) {
+    schedule_event(cpu, EV_LSQ, 1);
+  }
 }
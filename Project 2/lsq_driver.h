@@ -21,11 +21,17 @@ update_lsq_entry(APEX_CPU* cpu, enum STAGES FU_type);
 void
 broadcast_result_into_lsq(APEX_CPU* cpu, enum STAGES FU_type);
 
+int
+is_lsq_empty(APEX_CPU* cpu);
+
 void
 flush_lsq(APEX_CPU* cpu, int branch_id);
 
 void
 process_lsq(APEX_CPU* cpu);
 
+void
+print_lsq_entry(APEX_CPU* cpu, int i);
+
 void
 display_lsq(APEX_CPU* cpu);
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /*#define IQ_ENTRIES_NUMBER 3
 #define ROB_ENTRIES_NUMBER 3
@@ -17,12 +18,25 @@
 #define BIS_ENTRIES_NUMBER 3*/
 
 #include "cpu.h"
+#include "interval_driver.h"
+#include "checkpoint_driver.h"
+#include "debug_driver.h"
+#include "memory_driver.h"
+#include "device_driver.h"
+#include "trace_driver.h"
+#include "pipeview_driver.h"
+#include "chrome_driver.h"
+#include "series_driver.h"
+#include "live_driver.h"
+#include "profile_driver.h"
+#include "callstack_driver.h"
+#include "stall_driver.h"
 
 int
 main(int argc, char const* argv[])
 {
-  if (argc != 4) {
-    fprintf(stderr, "APEX_Help : Usage %s <input_file>\n", argv[0]);
+  if (argc < 4) {
+    fprintf(stderr, "APEX_Help : Usage %s <input_file> <simulate|display|interval|validate|debug|replay> <cycles> [options]\n", argv[0]);
     exit(1);
   }
 
@@ -33,7 +47,164 @@ main(int argc, char const* argv[])
     exit(1);
   }
 
-  APEX_cpu_run(cpu);
+  const char* restore_file = NULL;
+  const char* replay_file = NULL;
+  MODEL_CONFIG configs[REPLAY_CONFIGS_NUMBER];
+  int configs_number = 0;
+  for (int i = 4; i < argc; i++) {
+    if (strcmp(argv[i], "--skip-loops") == 0) {
+      cpu->loop.enabled = 1;
+    }
+    else if (strcmp(argv[i], "--every-cycle") == 0) {
+      cpu->scheduler.enabled = 0;
+    }
+    else if (strcmp(argv[i], "--delta-dump") == 0) {
+      cpu->delta.enabled = 1;
+    }
+    else if (strcmp(argv[i], "--histograms") == 0) {
+      cpu->occupancy.histograms = 1;
+      cpu->latency.histograms = 1;
+    }
+    else if (strcmp(argv[i], "--profile") == 0) {
+      if (start_profile(cpu, argv[1])) {
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[i], "--call-stacks") == 0 && i + 1 < argc) {
+      if (start_call_stacks(cpu, argv[1], argv[++i])) {
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[i], "--stall-interval") == 0 && i + 1 < argc) {
+      cpu->stalls.interval = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--save-checkpoint") == 0 && i + 1 < argc) {
+      cpu->checkpoint.filename = argv[++i];
+    }
+    else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+      cpu->checkpoint.interval = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--restore-checkpoint") == 0 && i + 1 < argc) {
+      restore_file = argv[++i];
+    }
+    else if (strcmp(argv[i], "--input-stream") == 0 && i + 1 < argc) {
+      if (open_input_stream(&cpu->devices, argv[++i])) {
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[i], "--output-stream") == 0 && i + 1 < argc) {
+      if (open_output_stream(&cpu->devices, argv[++i])) {
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[i], "--commit-trace") == 0 && i + 1 < argc) {
+      if (open_commit_trace(&cpu->trace, argv[++i])) {
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[i], "--pipeview") == 0 && i + 1 < argc) {
+      if (open_pipeview(&cpu->pipeview, argv[++i])) {
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[i], "--chrome-trace") == 0 && i + 1 < argc) {
+      if (open_chrome_trace(&cpu->chrome, argv[++i])) {
+        exit(1);
+      }
+    }
+    else if ((strcmp(argv[i], "--time-series") == 0 ||
+              strcmp(argv[i], "--time-series-binary") == 0) && i + 1 < argc) {
+      int binary = strcmp(argv[i], "--time-series-binary") == 0;
+      if (open_time_series(&cpu->series, argv[++i], binary)) {
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[i], "--series-cycles") == 0 && i + 1 < argc) {
+      cpu->series.interval = atoi(argv[++i]);
+      cpu->series.by_instructions = 0;
+    }
+    else if (strcmp(argv[i], "--series-instructions") == 0 && i + 1 < argc) {
+      cpu->series.interval = atoi(argv[++i]);
+      cpu->series.by_instructions = 1;
+    }
+    else if (strcmp(argv[i], "--live-stats") == 0 && i + 1 < argc) {
+      if (open_live_stats(cpu, argv[++i], argv[1])) {
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[i], "--replay-trace") == 0 && i + 1 < argc) {
+      replay_file = argv[++i];
+    }
+    else if (strcmp(argv[i], "--replay-config") == 0 && i + 1 < argc) {
+      if (configs_number == REPLAY_CONFIGS_NUMBER) {
+        fprintf(stderr, "APEX_Error : At most %d replay configurations\n", REPLAY_CONFIGS_NUMBER);
+        exit(1);
+      }
+      if (parse_model_config(argv[++i], &configs[configs_number++])) {
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[i], "--preload") == 0 && i + 1 < argc) {
+      if (preload_data_option(cpu, argv[++i])) {
+        exit(1);
+      }
+    }
+    else {
+      fprintf(stderr, "APEX_Error : Unknown option %s\n", argv[i]);
+      exit(1);
+    }
+  }
+
+  if (cpu->checkpoint.interval > 0 && !cpu->checkpoint.filename) {
+    fprintf(stderr, "APEX_Error : --checkpoint-every requires --save-checkpoint\n");
+    exit(1);
+  }
+  cpu->checkpoint.next_clock = cpu->checkpoint.interval;
+
+  if (restore_file) {
+    cpu = restore_checkpoint(cpu, restore_file);
+    if (!cpu) {
+      exit(1);
+    }
+  }
+  start_stall_intervals(cpu);
+  start_time_series(cpu);
+
+  if (strcmp(argv[2], "interval") == 0) {
+    interval_model_run(cpu);
+    display_interval_model(cpu);
+  }
+  else if (strcmp(argv[2], "validate") == 0) {
+    /* Run both models on the same program and compare IPC */
+    clock_t start = clock();
+    interval_model_run(cpu);
+    double interval_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    APEX_cpu_run(cpu);
+    double detailed_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    display_interval_model(cpu);
+    compare_interval_model(cpu, interval_time, detailed_time);
+  }
+  else if (strcmp(argv[2], "replay") == 0) {
+    if (!replay_file) {
+      fprintf(stderr, "APEX_Error : replay requires --replay-trace\n");
+      exit(1);
+    }
+    if (!configs_number) {
+      default_model_config(&configs[configs_number++]);
+    }
+    if (replay_trace_run(cpu, replay_file, configs, configs_number)) {
+      exit(1);
+    }
+  }
+  else if (strcmp(argv[2], "debug") == 0) {
+    APEX_cpu_debug(cpu);
+  }
+  else {
+    APEX_cpu_run(cpu);
+  }
   APEX_cpu_stop(cpu);
   return 0;
 }
@@ -0,0 +1,273 @@
+/*
+ *  memory_driver.c
+ *  Sparse paged data memory
+ *
+ *  Data memory is addressed by words 0 - 2^31-1. It is split into pages of
+ *  PAGE_WORDS words (4 KiB) found through a two level table: the directory
+ *  points to page tables, page tables point to pages. Tables and pages are
+ *  allocated when a word in their range is first written; reading a word that
+ *  was never written gives 0. The last translated page is kept in a one entry
+ *  TLB, so accesses that stay within a page skip the table walk.
+ *
+ *  Binary image files of 32-bit words in host byte order can be preloaded into
+ *  data memory. The image is mapped privately and pages it covers completely
+ *  point straight into the mapping, so they are read from the file on first
+ *  access and copied by the kernel only when the simulation writes to them.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cpu.h"
+#include "memory_driver.h"
+
+#define PAGE_BYTES (PAGE_WORDS * (long)sizeof(int))
+
+void
+init_data_memory(DATA_MEMORY* memory)
+{
+  memset(memory, 0, sizeof(*memory));
+  memory->tlb_page = -1;
+}
+
+/* Pages inside an image mapping are not allocated by us */
+static int
+is_borrowed_page(DATA_MEMORY* memory, int* words)
+{
+  for (int i = 0; i < memory->mappings_number; i++) {
+    char* base = memory->mappings[i].base;
+    if ((char*)words >= base && (char*)words < base + memory->mappings[i].size) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void
+free_data_memory(DATA_MEMORY* memory)
+{
+  for (int i = 0; i < PAGE_DIRECTORY_SIZE; i++) {
+    int** table = memory->directory[i];
+    if (!table) {
+      continue;
+    }
+    for (int j = 0; j < PAGE_TABLE_SIZE; j++) {
+      if (table[j] && !is_borrowed_page(memory, table[j])) {
+        free(table[j]);
+      }
+    }
+    free(table);
+  }
+  for (int i = 0; i < memory->mappings_number; i++) {
+    munmap(memory->mappings[i].base, memory->mappings[i].size);
+  }
+  init_data_memory(memory);
+}
+
+/*
+ * Returns the words of a page, or NULL if the page was never written.
+ * With allocate set a missing page is allocated and zeroed.
+ */
+int*
+get_memory_page(DATA_MEMORY* memory, int page, int allocate)
+{
+  int** table = memory->directory[page / PAGE_TABLE_SIZE];
+  if (!table) {
+    if (!allocate) {
+      return NULL;
+    }
+    table = calloc(PAGE_TABLE_SIZE, sizeof(int*));
+    if (!table) {
+      fprintf(stderr, "APEX_Error : Unable to allocate page table of data memory\n");
+      exit(1);
+    }
+    memory->directory[page / PAGE_TABLE_SIZE] = table;
+  }
+
+  int** entry = &table[page % PAGE_TABLE_SIZE];
+  if (!*entry && allocate) {
+    *entry = calloc(PAGE_WORDS, sizeof(int));
+    if (!*entry) {
+      fprintf(stderr, "APEX_Error : Unable to allocate page of data memory\n");
+      exit(1);
+    }
+    memory->pages_number++;
+  }
+  return *entry;
+}
+
+/* Returns the first page at or after the given one that was written, -1 if none */
+int
+next_memory_page(DATA_MEMORY* memory, int page)
+{
+  for (; page >= 0 && page < PAGE_DIRECTORY_SIZE * PAGE_TABLE_SIZE; page++) {
+    if (!memory->directory[page / PAGE_TABLE_SIZE]) {
+      page = (page / PAGE_TABLE_SIZE + 1) * PAGE_TABLE_SIZE - 1;
+      continue;
+    }
+    if (memory->directory[page / PAGE_TABLE_SIZE][page % PAGE_TABLE_SIZE]) {
+      return page;
+    }
+  }
+  return -1;
+}
+
+int
+read_memory(DATA_MEMORY* memory, int address)
+{
+  int page = address / PAGE_WORDS;
+  if (page != memory->tlb_page) {
+    int* words = get_memory_page(memory, page, 0);
+    if (!words) {
+      return 0;
+    }
+    memory->tlb_page = page;
+    memory->tlb_words = words;
+  }
+  return memory->tlb_words[address % PAGE_WORDS];
+}
+
+void
+write_memory(DATA_MEMORY* memory, int address, int value)
+{
+  int page = address / PAGE_WORDS;
+  if (page != memory->tlb_page) {
+    memory->tlb_page = page;
+    memory->tlb_words = get_memory_page(memory, page, 1);
+  }
+  memory->tlb_words[address % PAGE_WORDS] = value;
+}
+
+void
+write_memory_block(DATA_MEMORY* memory, int address, const int* words, long count)
+{
+  while (count > 0) {
+    int offset = address % PAGE_WORDS;
+    long chunk = PAGE_WORDS - offset;
+    if (chunk > count) {
+      chunk = count;
+    }
+    int* page = get_memory_page(memory, address / PAGE_WORDS, 1);
+    memcpy(&page[offset], words, sizeof(int) * chunk);
+    address += chunk;
+    words += chunk;
+    count -= chunk;
+  }
+}
+
+/* Copies every page of src into pages of dst owned by dst */
+void
+clone_data_memory(DATA_MEMORY* dst, DATA_MEMORY* src)
+{
+  init_data_memory(dst);
+  for (int page = next_memory_page(src, 0); page != -1; page = next_memory_page(src, page + 1)) {
+    memcpy(get_memory_page(dst, page, 1), get_memory_page(src, page, 0), PAGE_BYTES);
+  }
+}
+
+/* Points a page into an image mapping, releasing the page it replaces */
+static void
+borrow_page(DATA_MEMORY* memory, int page, int* words)
+{
+  int* old_words = get_memory_page(memory, page, 1);
+  if (!is_borrowed_page(memory, old_words)) {
+    free(old_words);
+  }
+  memory->directory[page / PAGE_TABLE_SIZE][page % PAGE_TABLE_SIZE] = words;
+  memory->tlb_page = -1;
+}
+
+/*
+ * Places the words of the image file in data memory from address on.
+ * Returns 0 on success, -1 if the file can not be read or does not fit.
+ */
+int
+preload_data_image(DATA_MEMORY* memory, const char* filename, int address)
+{
+  int fd = open(filename, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to open data image %s\n", filename);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+
+  long size = st.st_size;
+  long words = size / sizeof(int);
+  if (size % sizeof(int)) {
+    fprintf(stderr, "APEX_Error : Size of data image %s is not a multiple of 4 bytes\n", filename);
+    close(fd);
+    return -1;
+  }
+  if (address < 0 || address + words - 1 > 0x7fffffffL) {
+    fprintf(stderr, "APEX_Error : Data image %s at address %d is out of memory range\n",
+            filename, address);
+    close(fd);
+    return -1;
+  }
+  if (!words) {
+    close(fd);
+    return 0;
+  }
+
+  /* Writable, so borrowed pages are copied on the first write to them */
+  char* image = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED) {
+    fprintf(stderr, "APEX_Error : Unable to map data image %s\n", filename);
+    return -1;
+  }
+
+  /* Pages can only be borrowed when they line up with host pages of the mapping */
+  long host_page = sysconf(_SC_PAGESIZE);
+  int borrow = address % PAGE_WORDS == 0 && host_page > 0 && PAGE_BYTES % host_page == 0 &&
+               memory->mappings_number < MEMORY_MAPPINGS_NUMBER;
+  long full_pages = borrow ? words / PAGE_WORDS : 0;
+
+  for (long i = 0; i < full_pages; i++) {
+    borrow_page(memory, address / PAGE_WORDS + i, (int*)(image + i * PAGE_BYTES));
+  }
+  long copied = full_pages * PAGE_WORDS;
+  write_memory_block(memory, address + copied, (int*)image + copied, words - copied);
+
+  if (full_pages) {
+    memory->mappings[memory->mappings_number].base = image;
+    memory->mappings[memory->mappings_number].size = size;
+    memory->mappings_number++;
+  }
+  else {
+    munmap(image, size);
+  }
+  return 0;
+}
+
+/*
+ * Parses an option argument of the form <file>@<address>, the address is
+ * decimal or 0x hexadecimal, and preloads the image
+ */
+int
+preload_data_option(APEX_CPU* cpu, const char* argument)
+{
+  const char* at = strrchr(argument, '@');
+  char* end = NULL;
+  long address = at ? strtol(at + 1, &end, 0) : 0;
+  if (!at || at == argument || end == at + 1 || *end != '\0' || address != (int)address) {
+    fprintf(stderr, "APEX_Error : Expected <file>@<address>, got %s\n", argument);
+    return -1;
+  }
+
+  char filename[4096];
+  snprintf(filename, sizeof(filename), "%.*s", (int)(at - argument), argument);
+  return preload_data_image(&cpu->memory, filename, address);
+}
@@ -0,0 +1,37 @@
+/*
+ *  memory_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+void
+init_data_memory(DATA_MEMORY* memory);
+
+void
+free_data_memory(DATA_MEMORY* memory);
+
+int*
+get_memory_page(DATA_MEMORY* memory, int page, int allocate);
+
+int
+next_memory_page(DATA_MEMORY* memory, int page);
+
+int
+read_memory(DATA_MEMORY* memory, int address);
+
+void
+write_memory(DATA_MEMORY* memory, int address, int value);
+
+void
+write_memory_block(DATA_MEMORY* memory, int address, const int* words, long count);
+
+void
+clone_data_memory(DATA_MEMORY* dst, DATA_MEMORY* src);
+
+int
+preload_data_image(DATA_MEMORY* memory, const char* filename, int address);
+
+int
+preload_data_option(APEX_CPU* cpu, const char* argument);
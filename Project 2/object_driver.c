@@ -0,0 +1,190 @@
+/*
+ *  object_driver.c
+ *  Assembled APEX programs (object files)
+ *
+ *  An object file holds a header, the code memory as an array of fixed-width
+ *  APEX_Instruction records (five 32-bit integers in host byte order) and an
+ *  optional data segment that is copied into data memory at start-up. The
+ *  simulator maps the file and fetches straight from the mapping, so nothing is
+ *  parsed or copied when a program is loaded. Object files are written by
+ *  apex_asm.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cpu.h"
+#include "object_driver.h"
+#include "memory_driver.h"
+
+#define OBJECT_MAGIC "APEXOBJ"
+#define OBJECT_VERSION 1
+
+/* Alignment of sections in the file */
+#define OBJECT_ALIGN 64
+
+typedef struct OBJECT_HEADER
+{
+  char magic[8];
+  int version;
+  int instruction_size;    // sizeof(APEX_Instruction)
+  int code_size;    // number of instructions
+  int data_address;    // data memory address of the first word of the data segment
+  int data_size;    // number of words in the data segment
+  int reserved;
+  long code_offset;
+  long data_offset;
+} OBJECT_HEADER;
+
+static long
+align_offset(long offset)
+{
+  return (offset + OBJECT_ALIGN - 1) / OBJECT_ALIGN * OBJECT_ALIGN;
+}
+
+/* Returns 1 if filename starts with the object file magic */
+int
+is_object_file(const char* filename)
+{
+  char magic[8];
+  FILE* fp = fopen(filename, "rb");
+  if (!fp) {
+    return 0;
+  }
+  int found = fread(magic, sizeof(magic), 1, fp) == 1 &&
+              memcmp(magic, OBJECT_MAGIC, sizeof(magic)) == 0;
+  fclose(fp);
+  return found;
+}
+
+int
+write_object_file(const char* filename, const APEX_Instruction* code, int code_size,
+                  const int* data, int data_address, int data_size)
+{
+  OBJECT_HEADER header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, OBJECT_MAGIC, sizeof(header.magic));
+  header.version = OBJECT_VERSION;
+  header.instruction_size = sizeof(APEX_Instruction);
+  header.code_size = code_size;
+  header.data_address = data_address;
+  header.data_size = data_size;
+  header.code_offset = align_offset(sizeof(header));
+  if (data_size) {
+    header.data_offset = align_offset(header.code_offset + (long)code_size * sizeof(APEX_Instruction));
+  }
+
+  FILE* fp = fopen(filename, "wb");
+  if (!fp) {
+    fprintf(stderr, "APEX_Error : Unable to open object file %s\n", filename);
+    return -1;
+  }
+  int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+           fseek(fp, header.code_offset, SEEK_SET) == 0 &&
+           fwrite(code, sizeof(APEX_Instruction), code_size, fp) == (size_t)code_size;
+  if (ok && data_size) {
+    ok = fseek(fp, header.data_offset, SEEK_SET) == 0 &&
+         fwrite(data, sizeof(int), data_size, fp) == (size_t)data_size;
+  }
+  ok = (fclose(fp) == 0) && ok;
+  if (!ok) {
+    fprintf(stderr, "APEX_Error : Unable to write object file %s\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+static int
+is_valid_register(int reg)
+{
+  return reg >= 0 && reg <= 15;
+}
+
+static int
+is_valid_object(const OBJECT_HEADER* header, long size, const char* filename)
+{
+  if (header->version != OBJECT_VERSION || header->instruction_size != sizeof(APEX_Instruction)) {
+    fprintf(stderr, "APEX_Error : Object file %s has unsupported version %d\n", filename, header->version);
+    return 0;
+  }
+  if (header->code_size <= 0 || header->data_size < 0 ||
+      header->code_offset + (long)header->code_size * (long)sizeof(APEX_Instruction) > size ||
+      header->data_offset + (long)header->data_size * (long)sizeof(int) > size) {
+    fprintf(stderr, "APEX_Error : Object file %s is truncated\n", filename);
+    return 0;
+  }
+  if (header->data_address < 0 || header->data_address + (long)header->data_size - 1 > 0x7fffffffL) {
+    fprintf(stderr, "APEX_Error : Data segment of %s is out of memory range\n", filename);
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Maps an object file, points code memory into the mapping and copies the data
+ * segment into data memory. Returns the code memory or NULL on error.
+ */
+APEX_Instruction*
+load_object_file(APEX_CPU* cpu, const char* filename)
+{
+  int fd = open(filename, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < (long)sizeof(OBJECT_HEADER)) {
+    fprintf(stderr, "APEX_Error : Unable to open object file %s\n", filename);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return NULL;
+  }
+  long size = st.st_size;
+  char* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "APEX_Error : Unable to map object file %s\n", filename);
+    return NULL;
+  }
+
+  const OBJECT_HEADER* header = (const OBJECT_HEADER*)base;
+  if (!is_valid_object(header, size, filename)) {
+    munmap(base, size);
+    return NULL;
+  }
+
+  APEX_Instruction* code = (APEX_Instruction*)(base + header->code_offset);
+  for (int i = 0; i < header->code_size; i++) {
+    if (code[i].opcode_id < 0 || code[i].opcode_id >= NUM_OPCODES ||
+        !is_valid_register(code[i].rd) || !is_valid_register(code[i].rs1) ||
+        !is_valid_register(code[i].rs2)) {
+      fprintf(stderr, "APEX_Error : Invalid instruction %d in object file %s\n", i, filename);
+      munmap(base, size);
+      return NULL;
+    }
+  }
+
+  if (header->data_size) {
+    write_memory_block(&cpu->memory, header->data_address, (const int*)(base + header->data_offset),
+                       header->data_size);
+  }
+
+  cpu->code_memory_size = header->code_size;
+  cpu->code_map = base;
+  cpu->code_map_size = size;
+  return code;
+}
+
+void
+unload_object_file(APEX_CPU* cpu)
+{
+  munmap(cpu->code_map, cpu->code_map_size);
+  cpu->code_map = NULL;
+  cpu->code_memory = NULL;
+}
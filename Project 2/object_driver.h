@@ -0,0 +1,20 @@
+/*
+ *  object_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+int
+is_object_file(const char* filename);
+
+int
+write_object_file(const char* filename, const APEX_Instruction* code, int code_size,
+                  const int* data, int data_address, int data_size);
+
+APEX_Instruction*
+load_object_file(APEX_CPU* cpu, const char* filename);
+
+void
+unload_object_file(APEX_CPU* cpu);
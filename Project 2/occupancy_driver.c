@@ -0,0 +1,148 @@
+/*
+ *  occupancy_driver.c
+ *  Occupancy histograms of the IQ, ROB, LSQ, BIS and URF
+ *
+ *  After every simulated cycle the used entries of each structure are
+ *  counted and the cycles until the next evaluated one are added to the bin
+ *  of that count. Nothing changes in the cycles the scheduler skips, so the
+ *  histograms are the same as with sampling every cycle. Counting is a scan
+ *  of about a hundred flags, small next to the work of the cycle itself.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "occupancy_driver.h"
+
+static const char* structure_names[NUM_OCC_STRUCTURES] = {"IQ", "ROB", "LSQ", "BIS", "URF"};
+static const int structure_sizes[NUM_OCC_STRUCTURES] = {
+  IQ_ENTRIES_NUMBER, ROB_ENTRIES_NUMBER, LSQ_ENTRIES_NUMBER, BIS_ENTRIES_NUMBER, URF_ENTRIES_NUMBER
+};
+
+void
+init_occupancy(APEX_CPU* cpu)
+{
+  memset(&cpu->occupancy, 0, sizeof(cpu->occupancy));
+}
+
+/* Adds the current occupancy, which holds for the given number of cycles */
+void
+sample_occupancy(APEX_CPU* cpu, int cycles)
+{
+  int used[NUM_OCC_STRUCTURES] = {0};
+  for (int i = 0; i < IQ_ENTRIES_NUMBER; i++) {
+    used[OCC_IQ] += !cpu->iq.iq_entry[i].free;
+  }
+  for (int i = 0; i < ROB_ENTRIES_NUMBER; i++) {
+    used[OCC_ROB] += !cpu->rob.rob_entry[i].free;
+  }
+  for (int i = 0; i < LSQ_ENTRIES_NUMBER; i++) {
+    used[OCC_LSQ] += !cpu->lsq.lsq_entry[i].free;
+  }
+  for (int i = 0; i < BIS_ENTRIES_NUMBER; i++) {
+    used[OCC_BIS] += !cpu->bis.bis_entry[i].free;
+  }
+  for (int i = 0; i < URF_ENTRIES_NUMBER; i++) {
+    used[OCC_URF] += !cpu->urf[i].free;
+  }
+  for (int s = 0; s < NUM_OCC_STRUCTURES; s++) {
+    cpu->occupancy.cycles[s][used[s]] += cycles;
+  }
+}
+
+/* Called at every loop head, so the histograms of the last iteration are known */
+void
+mark_loop_occupancy(APEX_CPU* cpu)
+{
+  OCCUPANCY* occupancy = &cpu->occupancy;
+  for (int s = 0; s < NUM_OCC_STRUCTURES; s++) {
+    for (int n = 0; n <= structure_sizes[s]; n++) {
+      occupancy->loop_period[s][n] = occupancy->cycles[s][n] - occupancy->loop_mark[s][n];
+      occupancy->loop_mark[s][n] = occupancy->cycles[s][n];
+    }
+  }
+}
+
+/* Adds iterations skipped by the loop fast-forward like the last detailed one */
+void
+skip_loop_occupancy(APEX_CPU* cpu, int iterations)
+{
+  OCCUPANCY* occupancy = &cpu->occupancy;
+  for (int s = 0; s < NUM_OCC_STRUCTURES; s++) {
+    for (int n = 0; n <= structure_sizes[s]; n++) {
+      occupancy->cycles[s][n] += occupancy->loop_period[s][n] * iterations;
+    }
+  }
+}
+
+/* Cycles times entries used so far, so the difference over a span of cycles gives its mean */
+long
+occupancy_entry_cycles(APEX_CPU* cpu, int structure)
+{
+  long total = 0;
+  for (int n = 1; n <= structure_sizes[structure]; n++) {
+    total += n * cpu->occupancy.cycles[structure][n];
+  }
+  return total;
+}
+
+/* Returns the smallest occupancy at or below which the given share of cycles was spent */
+static int
+percentile(long* cycles, int size, long total, double share)
+{
+  long sum = 0;
+  for (int n = 0; n < size; n++) {
+    sum += cycles[n];
+    if (sum >= share * total) {
+      return n;
+    }
+  }
+  return size;
+}
+
+void
+display_occupancy_stats(APEX_CPU* cpu)
+{
+  printf("\n================================== OCCUPANCY ===================================\n");
+  printf("         |\t\t|\tMean\t|\tp50\t|\tp90\t|\tp99\t|\tMax\t|\tFull\t|\n");
+  for (int s = 0; s < NUM_OCC_STRUCTURES; s++) {
+    long* cycles = cpu->occupancy.cycles[s];
+    int size = structure_sizes[s];
+    long total = 0;
+    double sum = 0;
+    int max = 0;
+    for (int n = 0; n <= size; n++) {
+      total += cycles[n];
+      sum += (double)n * cycles[n];
+      if (cycles[n]) {
+        max = n;
+      }
+    }
+    if (!total) {
+      continue;
+    }
+    printf("         |\t%s %d\t|\t%.2f\t|\t%d\t|\t%d\t|\t%d\t|\t%d\t|\t%.1f%%\t|\n",
+           structure_names[s], size, sum / total,
+           percentile(cycles, size, total, 0.5), percentile(cycles, size, total, 0.9),
+           percentile(cycles, size, total, 0.99), max, 100.0 * cycles[size] / total);
+  }
+
+  if (cpu->occupancy.histograms) {
+    for (int s = 0; s < NUM_OCC_STRUCTURES; s++) {
+      long* cycles = cpu->occupancy.cycles[s];
+      printf("         |\t%s entries used\t|\tCycles\t|\n", structure_names[s]);
+      for (int n = 0; n <= structure_sizes[s]; n++) {
+        if (cycles[n]) {
+          printf("         |\t%d\t\t|\t%ld\t|\n", n, cycles[n]);
+        }
+      }
+    }
+  }
+  printf("================================================================================\n");
+}
@@ -0,0 +1,25 @@
+/*
+ *  occupancy_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+void
+init_occupancy(APEX_CPU* cpu);
+
+void
+sample_occupancy(APEX_CPU* cpu, int cycles);
+
+void
+mark_loop_occupancy(APEX_CPU* cpu);
+
+void
+skip_loop_occupancy(APEX_CPU* cpu, int iterations);
+
+long
+occupancy_entry_cycles(APEX_CPU* cpu, int structure);
+
+void
+display_occupancy_stats(APEX_CPU* cpu);
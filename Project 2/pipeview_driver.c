@@ -0,0 +1,193 @@
+/*
+ *  pipeview_driver.c
+ *  Pipeline view in the O3PipeView text format of gem5, read by Konata too
+ *
+ *  Every instruction gets one record as it leaves the pipeline, committed or
+ *  flushed, in the order that happens:
+ *
+ *    O3PipeView:fetch:<tick>:<pc>:0:<sequence>:<instruction>
+ *    O3PipeView:decode:<tick>       reached DRF
+ *    O3PipeView:rename:<tick>       dispatched, renaming is part of it
+ *    O3PipeView:dispatch:<tick>     entered the IQ
+ *    O3PipeView:issue:<tick>        left the IQ for Int_FU or Mul_FU
+ *    O3PipeView:complete:<tick>     result written, for LOAD after MEM
+ *    O3PipeView:retire:<tick>:store:<tick>
+ *
+ *  Ticks are cycles times PIPEVIEW_TICKS_PER_CYCLE, the 1 GHz clock gem5
+ *  assumes by default. A stage the instruction never reached has tick 0, and
+ *  flushed instructions retire at tick 0, which both viewers show as
+ *  squashed. Iterations skipped by the loop fast-forward have no records.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "pipeview_driver.h"
+
+#define PIPEVIEW_BUFFER_SIZE (1 << 20)
+
+int
+open_pipeview(PIPE_VIEW* view, const char* filename)
+{
+  view->file = fopen(filename, "w+");
+  if (!view->file) {
+    fprintf(stderr, "APEX_Error : Unable to open pipeline view %s\n", filename);
+    return -1;
+  }
+  setvbuf(view->file, NULL, _IOFBF, PIPEVIEW_BUFFER_SIZE);
+  view->bytes = 0;
+  view->retired = 0;
+  view->flushed = 0;
+  return 0;
+}
+
+void
+close_pipeview(PIPE_VIEW* view)
+{
+  if (view->file) {
+    fclose(view->file);
+  }
+  view->file = NULL;
+}
+
+/* Drops records written after the view was restored to an earlier point */
+void
+rewind_pipeview(PIPE_VIEW* view)
+{
+  if (!view->file) {
+    return;
+  }
+  fflush(view->file);
+  if (ftruncate(fileno(view->file), view->bytes) != 0 ||
+      fseek(view->file, view->bytes, SEEK_SET) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to rewind pipeline view\n");
+  }
+}
+
+static long
+tick(int clock)
+{
+  return clock > 0 ? (long)clock * PIPEVIEW_TICKS_PER_CYCLE : 0;
+}
+
+/* Writes the instruction in the assembly syntax, as the fetch stage prints it */
+static void
+format_instruction(char* text, int size, ROB_Entry* entry)
+{
+  switch (get_opcode_id(entry->opcode)) {
+    case OP_STORE:
+      snprintf(text, size, "%s,R%d,R%d,#%d", entry->opcode, entry->arch_rs1, entry->arch_rs2, entry->imm);
+      break;
+    case OP_LOAD:
+    case OP_ADDL:
+    case OP_SUBL:
+    case OP_JAL:
+      snprintf(text, size, "%s,R%d,R%d,#%d", entry->opcode, entry->arch_rd, entry->arch_rs1, entry->imm);
+      break;
+    case OP_MOVC:
+      snprintf(text, size, "%s,R%d,#%d", entry->opcode, entry->arch_rd, entry->imm);
+      break;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_AND:
+    case OP_OR:
+    case OP_EXOR:
+    case OP_MUL:
+      snprintf(text, size, "%s,R%d,R%d,R%d", entry->opcode, entry->arch_rd, entry->arch_rs1, entry->arch_rs2);
+      break;
+    case OP_BZ:
+    case OP_BNZ:
+      snprintf(text, size, "%s,#%d", entry->opcode, entry->imm);
+      break;
+    case OP_JUMP:
+      snprintf(text, size, "%s,R%d,#%d", entry->opcode, entry->arch_rs1, entry->imm);
+      break;
+    default:
+      snprintf(text, size, "%s", entry->opcode);
+      break;
+  }
+}
+
+/* Writes the record of an instruction leaving the pipeline, retire_clock 0 if it is flushed */
+void
+write_pipeview_record(APEX_CPU* cpu, ROB_Entry* entry, int retire_clock)
+{
+  PIPE_VIEW* view = &cpu->pipeview;
+  /* Room for the opcode and three operands of up to 11 characters each */
+  char text[sizeof(entry->opcode) + 64];
+  format_instruction(text, sizeof(text), entry);
+  int store = get_opcode_id(entry->opcode) == OP_STORE ? retire_clock : 0;
+
+  int length = fprintf(view->file,
+                       "O3PipeView:fetch:%ld:0x%08x:0:%ld:%s\n"
+                       "O3PipeView:decode:%ld\n"
+                       "O3PipeView:rename:%ld\n"
+                       "O3PipeView:dispatch:%ld\n"
+                       "O3PipeView:issue:%ld\n"
+                       "O3PipeView:complete:%ld\n"
+                       "O3PipeView:retire:%ld:store:%ld\n",
+                       tick(entry->fetch_clock), entry->pc, entry->sequence, text,
+                       tick(entry->decode_clock), tick(entry->dispatch_clock), tick(entry->dispatch_clock),
+                       tick(entry->issue_clock), tick(entry->complete_clock),
+                       tick(retire_clock), tick(store));
+  if (length < 0) {
+    fprintf(stderr, "APEX_Error : Unable to write pipeline view\n");
+    exit(1);
+  }
+  view->bytes += length;
+  if (retire_clock) {
+    view->retired++;
+  }
+  else {
+    view->flushed++;
+  }
+}
+
+/*
+ * Writes the instructions flushed from fetch and decode before dispatch.
+ * Fetch hands its instruction to decode unless decode is stalled, and
+ * decode keeps a dispatched one until the next arrives.
+ */
+void
+write_flushed_stages(APEX_CPU* cpu)
+{
+  CPU_Stage* stages[2] = {&cpu->stage[DRF], &cpu->stage[F]};
+  for (int i = 0; i < 2; i++) {
+    CPU_Stage* stage = stages[i];
+    if (strcmp(stage->opcode, "") == 0 || stage->rob_entry_id != -1 ||
+        (stage == &cpu->stage[F] && !stage->stalled)) {
+      continue;
+    }
+    ROB_Entry entry;
+    strcpy(entry.opcode, stage->opcode);
+    entry.pc = stage->pc;
+    entry.arch_rd = stage->arch_rd;
+    entry.arch_rs1 = stage->arch_rs1;
+    entry.arch_rs2 = stage->arch_rs2;
+    entry.imm = stage->imm;
+    entry.sequence = stage->sequence;
+    entry.fetch_clock = stage->fetch_clock;
+    entry.decode_clock = stage == &cpu->stage[DRF] ? stage->decode_clock : -1;
+    entry.dispatch_clock = -1;
+    entry.issue_clock = -1;
+    entry.complete_clock = -1;
+    write_pipeview_record(cpu, &entry, 0);
+  }
+}
+
+void
+display_pipeview_stats(APEX_CPU* cpu)
+{
+  printf("\n================================ PIPELINE VIEW =================================\n");
+  printf("         |\tCommitted instructions\t|\t%ld\t|\n", cpu->pipeview.retired);
+  printf("         |\tFlushed instructions\t|\t%ld\t|\n", cpu->pipeview.flushed);
+  printf("         |\tBytes written\t\t|\t%ld\t|\n", cpu->pipeview.bytes);
+  printf("================================================================================\n");
+}
@@ -0,0 +1,27 @@
+/*
+ *  pipeview_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#define PIPEVIEW_TICKS_PER_CYCLE 1000
+
+int
+open_pipeview(PIPE_VIEW* view, const char* filename);
+
+void
+close_pipeview(PIPE_VIEW* view);
+
+void
+rewind_pipeview(PIPE_VIEW* view);
+
+void
+write_pipeview_record(APEX_CPU* cpu, ROB_Entry* entry, int retire_clock);
+
+void
+write_flushed_stages(APEX_CPU* cpu);
+
+void
+display_pipeview_stats(APEX_CPU* cpu);
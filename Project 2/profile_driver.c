@@ -0,0 +1,266 @@
+/*
+ *  profile_driver.c
+ *  Hot-spot profile of the static instructions of the program
+ *
+ *  Each instruction of code memory has counters of
+ *    executed     times it committed
+ *    head cycles  cycles it spent at the ROB head, charged at the end of
+ *                 every simulated cycle and for the cycles skipped after it
+ *    IQ wait      cycles between its dispatch and its issue, summed over
+ *                 its committed executions
+ *    flushes      times it redirected fetch through control_flow
+ *  The listing at the end of the run shows the executed instructions sorted
+ *  by head cycles, with their line of the .asm source. Object files carry no
+ *  source, their instructions are shown disassembled.
+ *
+ *  Counters live outside of APEX_CPU, so in debug mode cycles simulated
+ *  again after going back are counted again.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "profile_driver.h"
+
+typedef struct PROFILE_COUNTERS
+{
+  long executed;
+  long head_cycles;
+  long iq_wait;
+  long flushes;
+} PROFILE_COUNTERS;
+
+typedef struct PROFILE
+{
+  const char* filename;    // source of the program
+  int size;    // instructions of code memory
+  PROFILE_COUNTERS* counters;
+  PROFILE_COUNTERS* loop_mark;    // counters at the last loop head
+  PROFILE_COUNTERS* loop_period;    // counters of the last loop iteration
+} PROFILE;
+
+int
+start_profile(APEX_CPU* cpu, const char* filename)
+{
+  PROFILE* profile = calloc(1, sizeof(PROFILE));
+  if (profile) {
+    profile->counters = calloc(cpu->code_memory_size, sizeof(PROFILE_COUNTERS));
+    profile->loop_mark = calloc(cpu->code_memory_size, sizeof(PROFILE_COUNTERS));
+    profile->loop_period = calloc(cpu->code_memory_size, sizeof(PROFILE_COUNTERS));
+  }
+  if (!profile || !profile->counters || !profile->loop_mark || !profile->loop_period) {
+    fprintf(stderr, "APEX_Error : Unable to allocate the profile\n");
+    if (profile) {
+      free(profile->counters);
+      free(profile->loop_mark);
+      free(profile->loop_period);
+      free(profile);
+    }
+    return -1;
+  }
+  profile->filename = filename;
+  profile->size = cpu->code_memory_size;
+  cpu->profile = profile;
+  return 0;
+}
+
+void
+free_profile(APEX_CPU* cpu)
+{
+  if (!cpu->profile) {
+    return;
+  }
+  free(cpu->profile->counters);
+  free(cpu->profile->loop_mark);
+  free(cpu->profile->loop_period);
+  free(cpu->profile);
+  cpu->profile = NULL;
+}
+
+/* Returns the counters of the instruction at pc, NULL outside of code memory */
+static PROFILE_COUNTERS*
+get_counters(PROFILE* profile, int pc)
+{
+  int index = get_code_index(pc);
+  if (pc < 4000 || index >= profile->size) {
+    return NULL;
+  }
+  return &profile->counters[index];
+}
+
+/* Called as the instruction leaves the ROB */
+void
+profile_retired_entry(APEX_CPU* cpu, ROB_Entry* entry)
+{
+  PROFILE_COUNTERS* counters = get_counters(cpu->profile, entry->pc);
+  if (!counters) {
+    return;
+  }
+  counters->executed++;
+  if (entry->issue_clock >= 0) {
+    counters->iq_wait += entry->issue_clock - entry->dispatch_clock;
+  }
+}
+
+/* Called by control_flow with the PC of the redirecting instruction */
+void
+profile_flush(APEX_CPU* cpu, int pc)
+{
+  PROFILE_COUNTERS* counters = get_counters(cpu->profile, pc);
+  if (counters) {
+    counters->flushes++;
+  }
+}
+
+/* Called at the end of every simulated cycle, which holds for the given number of cycles */
+void
+profile_cycle(APEX_CPU* cpu, int cycles)
+{
+  ROB_Entry* head = &cpu->rob.rob_entry[cpu->rob.head];
+  if (head->free) {
+    return;
+  }
+  PROFILE_COUNTERS* counters = get_counters(cpu->profile, head->pc);
+  if (counters) {
+    counters->head_cycles += cycles;
+  }
+}
+
+/* Called at every loop head, so the counters of the last iteration are known */
+void
+mark_loop_profile(APEX_CPU* cpu)
+{
+  PROFILE* profile = cpu->profile;
+  for (int i = 0; i < profile->size; i++) {
+    PROFILE_COUNTERS* now = &profile->counters[i];
+    PROFILE_COUNTERS* mark = &profile->loop_mark[i];
+    PROFILE_COUNTERS* period = &profile->loop_period[i];
+    period->executed = now->executed - mark->executed;
+    period->head_cycles = now->head_cycles - mark->head_cycles;
+    period->iq_wait = now->iq_wait - mark->iq_wait;
+    period->flushes = now->flushes - mark->flushes;
+    *mark = *now;
+  }
+}
+
+/* Adds iterations skipped by the loop fast-forward like the last detailed one */
+void
+skip_loop_profile(APEX_CPU* cpu, int iterations)
+{
+  PROFILE* profile = cpu->profile;
+  for (int i = 0; i < profile->size; i++) {
+    PROFILE_COUNTERS* now = &profile->counters[i];
+    PROFILE_COUNTERS* period = &profile->loop_period[i];
+    now->executed += period->executed * iterations;
+    now->head_cycles += period->head_cycles * iterations;
+    now->iq_wait += period->iq_wait * iterations;
+    now->flushes += period->flushes * iterations;
+  }
+}
+
+static PROFILE_COUNTERS* sort_counters;
+
+/* Most head cycles first, then program order */
+static int
+compare_hot_spots(const void* a, const void* b)
+{
+  int i = *(const int*)a;
+  int j = *(const int*)b;
+  if (sort_counters[i].head_cycles != sort_counters[j].head_cycles) {
+    return sort_counters[i].head_cycles < sort_counters[j].head_cycles ? 1 : -1;
+  }
+  return i - j;
+}
+
+/*
+ * Reads the source lines of the listed instructions, text[i] of the i-th
+ * listed one. Returns 0 if the source can not be read.
+ */
+static int
+read_source_lines(PROFILE* profile, const int* code_lines, const int* order, int count, char** text)
+{
+  FILE* fp = fopen(profile->filename, "r");
+  if (!fp || !code_lines) {
+    if (fp) {
+      fclose(fp);
+    }
+    return 0;
+  }
+
+  char* line = NULL;
+  size_t len = 0;
+  int line_number = 0;
+  while (getline(&line, &len, fp) != -1) {
+    line_number++;
+    for (int k = 0; k < count; k++) {
+      if (code_lines[order[k]] != line_number) {
+        continue;
+      }
+      char* start = line;
+      while (*start == ' ' || *start == '\t') {
+        start++;
+      }
+      start[strcspn(start, "\r\n")] = '\0';
+      text[k] = strdup(start);
+    }
+  }
+  free(line);
+  fclose(fp);
+  return 1;
+}
+
+void
+display_profile(APEX_CPU* cpu)
+{
+  PROFILE* profile = cpu->profile;
+  int* order = malloc(sizeof(int) * profile->size);
+  char** text = calloc(profile->size, sizeof(char*));
+  if (!order || !text) {
+    free(order);
+    free(text);
+    return;
+  }
+
+  int count = 0;
+  long total_cycles = 0;
+  for (int i = 0; i < profile->size; i++) {
+    total_cycles += profile->counters[i].head_cycles;
+    if (profile->counters[i].executed || profile->counters[i].head_cycles) {
+      order[count++] = i;
+    }
+  }
+  sort_counters = profile->counters;
+  qsort(order, count, sizeof(int), compare_hot_spots);
+  int have_source = read_source_lines(profile, cpu->code_lines, order, count, text);
+
+  printf("\n=================================== PROFILE ====================================\n");
+  printf("         |\tPC\t|\tHead\t|\tHead%%\t|\tExecuted\t|\tIQ wait\t|\tFlushes\t|\t%s\n",
+         have_source ? "Line: Source" : "Instruction");
+  for (int k = 0; k < count; k++) {
+    int i = order[k];
+    PROFILE_COUNTERS* counters = &profile->counters[i];
+    double iq_wait = counters->executed ? (double)counters->iq_wait / counters->executed : 0.0;
+    printf("         |\t%d\t|\t%ld\t|\t%.1f%%\t|\t%ld\t\t|\t%.2f\t|\t%ld\t|\t",
+           4000 + 4 * i, counters->head_cycles,
+           total_cycles ? 100.0 * counters->head_cycles / total_cycles : 0.0,
+           counters->executed, iq_wait, counters->flushes);
+    if (text[k]) {
+      printf("%d: %s\n", cpu->code_lines[i], text[k]);
+    }
+    else {
+      APEX_Instruction* ins = &cpu->code_memory[i];
+      printf("%s rd=%d rs1=%d rs2=%d imm=%d\n",
+             get_opcode_name(ins->opcode_id), ins->rd, ins->rs1, ins->rs2, ins->imm);
+    }
+    free(text[k]);
+  }
+  printf("================================================================================\n");
+  free(order);
+  free(text);
+}
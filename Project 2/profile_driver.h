@@ -0,0 +1,31 @@
+/*
+ *  profile_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+int
+start_profile(APEX_CPU* cpu, const char* filename);
+
+void
+free_profile(APEX_CPU* cpu);
+
+void
+profile_retired_entry(APEX_CPU* cpu, ROB_Entry* entry);
+
+void
+profile_flush(APEX_CPU* cpu, int pc);
+
+void
+profile_cycle(APEX_CPU* cpu, int cycles);
+
+void
+mark_loop_profile(APEX_CPU* cpu);
+
+void
+skip_loop_profile(APEX_CPU* cpu, int iterations);
+
+void
+display_profile(APEX_CPU* cpu);
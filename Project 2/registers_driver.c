@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include "cpu.h"
+#include "memory_driver.h"
 
 int
 is_phys_reg_free(APEX_CPU* cpu)
@@ -171,9 +172,9 @@ print_datamemory_for_debug(APEX_CPU* cpu)
 {
   printf("-------------------------- Details of Data Memory State -------------------------\n");
   for (int i = 0; i < 100; i++) {
-    if (cpu->data_memory[i]) {
+    if (read_memory(&cpu->memory, i)) {
       printf("| D[%d] = %d |",
-              i, cpu->data_memory[i]);
+              i, read_memory(&cpu->memory, i));
     }
   }
   printf("\n");
@@ -274,7 +275,7 @@ display_data_mem(APEX_CPU* cpu)
   printf("\n============================= STATE OF DATA MEMORY =============================\n");
   for (int i = 0; i < 100; i++) {
     printf("                     |\tMEM[%d]\t|\tData Value = %d\t|\n",
-            i, cpu->data_memory[i]);
+            i, read_memory(&cpu->memory, i));
   }
   printf("================================================================================\n\n");
 }
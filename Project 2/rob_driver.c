@@ -16,6 +16,36 @@
 #include "lsq_driver.h"
 #include "registers_driver.h"
 #include "branch_driver.h"
+#include "scheduler_driver.h"
+#include "trace_driver.h"
+#include "latency_driver.h"
+#include "pipeview_driver.h"
+#include "chrome_driver.h"
+#include "profile_driver.h"
+#include "callstack_driver.h"
+#include "log_driver.h"
+
+/* Hands the instruction leaving the ROB to the traces and statistics */
+static void
+record_retired_entry(APEX_CPU* cpu, ROB_Entry* entry)
+{
+  if (cpu->trace.writer) {
+    trace_rob_entry(cpu, entry);
+  }
+  record_latency(cpu, entry);
+  if (cpu->pipeview.file) {
+    write_pipeview_record(cpu, entry, cpu->clock);
+  }
+  if (cpu->chrome.file) {
+    trace_commit(cpu, entry);
+  }
+  if (cpu->profile) {
+    profile_retired_entry(cpu, entry);
+  }
+  if (cpu->call_graph) {
+    call_stack_retired_entry(cpu, entry);
+  }
+}
 
 int
 is_rob_empty(APEX_CPU* cpu)
@@ -59,6 +89,18 @@ push_rob_entry(APEX_CPU* cpu, ROB_Entry* new_rob_entry)
   cpu->rob.rob_entry[free_entry].arch_rs2 = new_rob_entry->arch_rs2;
   cpu->rob.rob_entry[free_entry].phys_rs2 = new_rob_entry->phys_rs2;
   cpu->rob.rob_entry[free_entry].imm = new_rob_entry->imm;
+  cpu->rob.rob_entry[free_entry].mem_address = 0;
+  cpu->rob.rob_entry[free_entry].taken = 0;
+  cpu->rob.rob_entry[free_entry].fetch_clock = new_rob_entry->fetch_clock;
+  cpu->rob.rob_entry[free_entry].decode_clock = new_rob_entry->decode_clock;
+  cpu->rob.rob_entry[free_entry].dispatch_clock = cpu->clock;
+  cpu->rob.rob_entry[free_entry].issue_clock = -1;
+  cpu->rob.rob_entry[free_entry].memory_clock = -1;
+  cpu->rob.rob_entry[free_entry].complete_clock = new_rob_entry->status ? cpu->clock : -1;
+  cpu->rob.rob_entry[free_entry].sequence = new_rob_entry->sequence;
+  if (new_rob_entry->status) {
+    schedule_event(cpu, EV_COMMIT, 1);
+  }
   cpu->rob.tail++;
   if (cpu->rob.tail == ROB_ENTRIES_NUMBER) {
     cpu->rob.tail = 0;
@@ -92,6 +134,7 @@ commit_rob_entry(APEX_CPU* cpu)
 
     if (strcmp(cpu->rob.rob_entry[cpu->rob.head].opcode, "HALT") == 0) {
       if (cpu->mem_cycle == 1 && strcmp(cpu->stage[MEM].opcode, "") == 0) {
+        record_retired_entry(cpu, &cpu->rob.rob_entry[cpu->rob.head]);
         cpu->rob.rob_entry[cpu->rob.head].free = 1;    // making free ROB entry after commitment
         cpu->rob.head++;
         if (cpu->rob.head == ROB_ENTRIES_NUMBER) {
@@ -100,20 +143,34 @@ commit_rob_entry(APEX_CPU* cpu)
       }
     }
     else {
+      record_retired_entry(cpu, &cpu->rob.rob_entry[cpu->rob.head]);
+      TRACE(cpu, TRACE_COMMIT, 1, "pc(%d) %s committed", cpu->rob.rob_entry[cpu->rob.head].pc,
+            cpu->rob.rob_entry[cpu->rob.head].opcode);
       cpu->rob.rob_entry[cpu->rob.head].free = 1;    // making free ROB entry after commitment
       cpu->rob.head++;
       if (cpu->rob.head == ROB_ENTRIES_NUMBER) {
         cpu->rob.head = 0;
       }
       cpu->commitments++;
+      cpu->instructions_committed++;
     }
 
     if (cpu->fill_in_rob > 2 && is_rob_empty(cpu)) {
       cpu->simulation_completed = 1;
     }
+
+    /* Commit released entries, next head may be ready as well */
+    schedule_event(cpu, EV_COMMIT, 1);
+    schedule_event(cpu, EV_LSQ, 0);
+    schedule_event(cpu, EV_DECODE, 0);
     return 1;
   }
 
+  /* Empty ROB is checked every cycle to detect the end of simulation */
+  if (is_rob_empty(cpu)) {
+    schedule_event(cpu, EV_COMMIT, 1);
+  }
+
   if (cpu->fill_in_rob > 2 && is_rob_empty(cpu) &&
       cpu->mem_cycle == 1 && strcmp(cpu->stage[MEM].opcode, "") == 0) {
     cpu->simulation_completed = 1;
@@ -127,6 +184,8 @@ update_rob_entry(APEX_CPU* cpu, enum STAGES FU_type)
 {
   int rob_entry_id = cpu->stage[FU_type].rob_entry_id;
   cpu->rob.rob_entry[rob_entry_id].status = 1;
+  cpu->rob.rob_entry[rob_entry_id].complete_clock = cpu->clock;
+  schedule_event(cpu, EV_COMMIT, 1);
   return 0;
 }
 
@@ -134,12 +193,16 @@ void
 remove_store_from_rob(APEX_CPU* cpu)
 {
   int head = cpu->rob.head;
+  record_retired_entry(cpu, &cpu->rob.rob_entry[head]);
   cpu->rob.rob_entry[head].free = 1;
   cpu->rob.rob_entry[head].status = 1;
   cpu->rob.head++;
   if (cpu->rob.head == ROB_ENTRIES_NUMBER) {
     cpu->rob.head = 0;
   }
+  cpu->instructions_committed++;
+  schedule_event(cpu, EV_COMMIT, 1);
+  schedule_event(cpu, EV_DECODE, 0);
 }
 
 void
@@ -158,6 +221,24 @@ print_rob_for_debug(APEX_CPU* cpu)
   printf("Tail: %d, Head: %d\n\n", cpu->rob.tail, cpu->rob.head);
 }
 
+/* Prints the instruction of the entry as in display_rob */
+void
+print_rob_entry(APEX_CPU* cpu, int i)
+{
+  CPU_Stage instruction_to_print;
+  printf("pc(%d)  ", cpu->rob.rob_entry[i].pc);
+  strcpy(instruction_to_print.opcode, cpu->rob.rob_entry[i].opcode);
+  instruction_to_print.arch_rs1 = cpu->rob.rob_entry[i].arch_rs1;
+  instruction_to_print.phys_rs1 = cpu->rob.rob_entry[i].phys_rs1;
+  instruction_to_print.arch_rs2 = cpu->rob.rob_entry[i].arch_rs2;
+  instruction_to_print.phys_rs2 = cpu->rob.rob_entry[i].phys_rs2;
+  instruction_to_print.arch_rd = cpu->rob.rob_entry[i].arch_rd;
+  instruction_to_print.phys_rd = cpu->rob.rob_entry[i].phys_rd;
+  instruction_to_print.imm = cpu->rob.rob_entry[i].imm;
+  print_instruction(0, &instruction_to_print);
+  printf("\t|");
+}
+
 void
 display_rob(APEX_CPU* cpu)
 {
@@ -183,18 +264,7 @@ display_rob(APEX_CPU* cpu)
 
       printf("\t");
       if (!cpu->rob.rob_entry[i].free) {
-      printf("pc(%d)  ", cpu->rob.rob_entry[i].pc);
-        CPU_Stage* instruction_to_print = malloc(sizeof(*instruction_to_print));
-        strcpy(instruction_to_print->opcode, cpu->rob.rob_entry[i].opcode);
-        instruction_to_print->arch_rs1 = cpu->rob.rob_entry[i].arch_rs1;
-        instruction_to_print->phys_rs1 = cpu->rob.rob_entry[i].phys_rs1;
-        instruction_to_print->arch_rs2 = cpu->rob.rob_entry[i].arch_rs2;
-        instruction_to_print->phys_rs2 = cpu->rob.rob_entry[i].phys_rs2;
-        instruction_to_print->arch_rd = cpu->rob.rob_entry[i].arch_rd;
-        instruction_to_print->phys_rd = cpu->rob.rob_entry[i].phys_rd;
-        instruction_to_print->imm = cpu->rob.rob_entry[i].imm;
-        print_instruction(0, instruction_to_print);
-        printf("\t|");
+        print_rob_entry(cpu, i);
       }
       printf("\n");
     }
@@ -205,10 +275,10 @@ display_rob(APEX_CPU* cpu)
 int
 find_branch_in_rob(APEX_CPU* cpu)
 {
-  for (int i = 0; i < ROB_ENTRIES_NUMBER; i++) {
-    if (!cpu->rob.rob_entry[i].free && cpu->rob.rob_entry[i].pc == cpu->stage[Int_FU].pc) {
-      return i;
-    }
+  /* A loop may hold several instances of the branch, its PC does not tell them apart */
+  int rob_id = cpu->stage[Int_FU].rob_entry_id;
+  if (rob_id >= 0 && !cpu->rob.rob_entry[rob_id].free) {
+    return rob_id;
   }
   return -1;
 }
@@ -271,7 +341,7 @@ flush_rob(APEX_CPU* cpu)
 
   cpu->rob.tail--;
   if (cpu->rob.tail < 0) {
-    cpu->rob.tail = ROB_ENTRIES_NUMBER;
+    cpu->rob.tail = ROB_ENTRIES_NUMBER - 1;
   }
 
   if (cpu->rob.tail != branch_index_in_rob) {
@@ -282,6 +352,9 @@ flush_rob(APEX_CPU* cpu)
             int phys_reg_to_deallocate = cpu->rob.rob_entry[cpu->rob.tail].phys_rd;
             deallocate_phys_reg(cpu, phys_reg_to_deallocate);
           }
+          if (cpu->pipeview.file) {
+            write_pipeview_record(cpu, &cpu->rob.rob_entry[cpu->rob.tail], 0);
+          }
           cpu->rob.rob_entry[cpu->rob.tail].free = 1;
         }
         cpu->rob.tail--;
@@ -294,6 +367,9 @@ flush_rob(APEX_CPU* cpu)
             int phys_reg_to_deallocate = cpu->rob.rob_entry[cpu->rob.tail].phys_rd;
             deallocate_phys_reg(cpu, phys_reg_to_deallocate);
           }
+          if (cpu->pipeview.file) {
+            write_pipeview_record(cpu, &cpu->rob.rob_entry[cpu->rob.tail], 0);
+          }
           cpu->rob.rob_entry[cpu->rob.tail].free = 1;
         }
         cpu->rob.tail--;
@@ -306,6 +382,9 @@ flush_rob(APEX_CPU* cpu)
             int phys_reg_to_deallocate = cpu->rob.rob_entry[cpu->rob.tail].phys_rd;
             deallocate_phys_reg(cpu, phys_reg_to_deallocate);
           }
+          if (cpu->pipeview.file) {
+            write_pipeview_record(cpu, &cpu->rob.rob_entry[cpu->rob.tail], 0);
+          }
           cpu->rob.rob_entry[cpu->rob.tail].free = 1;
         }
         cpu->rob.tail--;
@@ -313,4 +392,7 @@ flush_rob(APEX_CPU* cpu)
     }
   }
   cpu->rob.tail = branch_index_in_rob + 1;
+  if (cpu->rob.tail == ROB_ENTRIES_NUMBER) {
+    cpu->rob.tail = 0;
+  }
 }
@@ -6,6 +6,9 @@
  *  State University of New York, Binghamton
  */
 
+int
+is_rob_empty(APEX_CPU* cpu);
+
 int
 is_rob_entry_free(APEX_CPU* cpu);
 
@@ -24,5 +27,8 @@ remove_store_from_rob(APEX_CPU* cpu);
 void
 flush_rob(APEX_CPU* cpu);
 
+void
+print_rob_entry(APEX_CPU* cpu, int i);
+
 void
 display_rob(APEX_CPU* cpu);
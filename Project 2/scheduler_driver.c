@@ -0,0 +1,144 @@
+/*
+ *  scheduler_driver.c
+ *  Discrete-event scheduler built on a timing wheel
+ *
+ *  Components of the pipeline (enum COMPONENTS) are evaluated only in cycles
+ *  for which a wakeup was scheduled: FU completion, memory response, release
+ *  of a ROB, IQ, LSQ, URF or BIS entry, or a new instruction in a latch. A
+ *  component scheduled with delay 0 by a component evaluated earlier in the
+ *  same cycle is evaluated in that cycle. Cycles without any event are skipped.
+ *
+ *  When the scheduler is disabled every component is evaluated every cycle,
+ *  which is needed by display mode.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "scheduler_driver.h"
+
+void
+init_scheduler(APEX_CPU* cpu, int enabled)
+{
+  memset(&cpu->scheduler, 0, sizeof(cpu->scheduler));
+  cpu->scheduler.enabled = enabled;
+
+  /* Fetch and commit start the pipeline */
+  schedule_event(cpu, EV_FETCH, 0);
+  schedule_event(cpu, EV_COMMIT, 0);
+}
+
+void
+schedule_event(APEX_CPU* cpu, enum COMPONENTS component, int delay)
+{
+  SCHEDULER* scheduler = &cpu->scheduler;
+  if (delay < WHEEL_SIZE) {
+    scheduler->wheel[(scheduler->now + delay) % WHEEL_SIZE] |= 1u << component;
+    return;
+  }
+
+  int cycle = scheduler->now + delay;
+  for (int i = 0; i < scheduler->far_count; i++) {
+    if (scheduler->far_cycle[i] == cycle) {
+      scheduler->far_mask[i] |= 1u << component;
+      return;
+    }
+  }
+  if (scheduler->far_count == FAR_EVENTS_NUMBER) {
+    fprintf(stderr, "APEX_Error : Too many pending events\n");
+    exit(1);
+  }
+  scheduler->far_cycle[scheduler->far_count] = cycle;
+  scheduler->far_mask[scheduler->far_count] = 1u << component;
+  scheduler->far_count++;
+}
+
+/*
+ * Returns 1 if the component has to be evaluated in the current cycle
+ */
+int
+has_event(APEX_CPU* cpu, enum COMPONENTS component)
+{
+  SCHEDULER* scheduler = &cpu->scheduler;
+  if (!scheduler->enabled) {
+    return 1;
+  }
+  if (scheduler->wheel[scheduler->now % WHEEL_SIZE] & (1u << component)) {
+    scheduler->evaluations++;
+    return 1;
+  }
+  return 0;
+}
+
+/* Moves far events that came within the range of the wheel */
+static void
+refill_wheel(SCHEDULER* scheduler)
+{
+  int i = 0;
+  while (i < scheduler->far_count) {
+    if (scheduler->far_cycle[i] - scheduler->now < WHEEL_SIZE) {
+      scheduler->wheel[scheduler->far_cycle[i] % WHEEL_SIZE] |= scheduler->far_mask[i];
+      scheduler->far_count--;
+      scheduler->far_cycle[i] = scheduler->far_cycle[scheduler->far_count];
+      scheduler->far_mask[i] = scheduler->far_mask[scheduler->far_count];
+    }
+    else {
+      i++;
+    }
+  }
+}
+
+/*
+ * Ends the current cycle. Returns the number of cycles until the next
+ * cycle with an event, or -1 if nothing is scheduled anymore.
+ */
+int
+advance_scheduler(APEX_CPU* cpu)
+{
+  SCHEDULER* scheduler = &cpu->scheduler;
+  scheduler->wheel[scheduler->now % WHEEL_SIZE] = 0;
+  scheduler->now++;
+  if (!scheduler->enabled) {
+    return 1;
+  }
+
+  int cycles = 1;
+  for (;;) {
+    refill_wheel(scheduler);
+    if (scheduler->wheel[scheduler->now % WHEEL_SIZE]) {
+      return cycles;
+    }
+
+    int next = -1;
+    for (int i = 1; i < WHEEL_SIZE; i++) {
+      if (scheduler->wheel[(scheduler->now + i) % WHEEL_SIZE]) {
+        next = i;
+        break;
+      }
+    }
+    if (next == -1) {
+      if (!scheduler->far_count) {
+        return -1;
+      }
+      next = WHEEL_SIZE - 1;
+    }
+    scheduler->now += next;
+    scheduler->idle_cycles += next;
+    cycles += next;
+  }
+}
+
+void
+display_scheduler_stats(APEX_CPU* cpu)
+{
+  printf("\n================================== SCHEDULER ===================================\n");
+  printf("         |\tComponent evaluations\t|\t%ld\t|\n", cpu->scheduler.evaluations);
+  printf("         |\tIdle cycles skipped\t|\t%ld\t|\n", cpu->scheduler.idle_cycles);
+  printf("================================================================================\n");
+}
@@ -0,0 +1,22 @@
+/*
+ *  scheduler_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+void
+init_scheduler(APEX_CPU* cpu, int enabled);
+
+void
+schedule_event(APEX_CPU* cpu, enum COMPONENTS component, int delay);
+
+int
+has_event(APEX_CPU* cpu, enum COMPONENTS component);
+
+int
+advance_scheduler(APEX_CPU* cpu);
+
+void
+display_scheduler_stats(APEX_CPU* cpu);
@@ -0,0 +1,224 @@
+/*
+ *  series_driver.c
+ *  Time series of the stats of fixed intervals of the run
+ *
+ *  The run is cut into intervals of a number of cycles, or of committed
+ *  instructions, and one record is written per interval:
+ *
+ *    start      first cycle of the interval
+ *    cycles     cycles of the interval
+ *    committed  instructions committed
+ *    ipc        committed / cycles, CSV only
+ *    flushes    times control_flow redirected fetch
+ *    loads      LOADs committed
+ *    stores     STOREs committed
+ *    iq rob lsq mean entries used
+ *
+ *  A record ends with the first simulated cycle at or after the end of its
+ *  interval, so it covers more than the interval when the scheduler or the
+ *  loop fast-forward skip across that end. Interval ends are multiples of
+ *  the interval length. The last record holds what is left when the run stops.
+ *
+ *  The CSV file starts with a line of the column names. The binary file
+ *  starts with a header of SERIES_HEADER_SIZE bytes: the magic "APEXSERS",
+ *  the format version, 0 for intervals of cycles or 1 for instructions, the
+ *  interval length and the record size. Records of SERIES_RECORD follow, ints
+ *  and floats of 4 bytes in host byte order.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "series_driver.h"
+#include "occupancy_driver.h"
+
+#define SERIES_BUFFER_SIZE (1 << 16)
+#define SERIES_DEFAULT_INTERVAL 1000
+
+typedef struct SERIES_RECORD
+{
+  int start;
+  int cycles;
+  int committed;
+  int flushes;
+  int loads;
+  int stores;
+  float occupancy[NUM_OCC_QUEUES];    // IQ, ROB and LSQ
+} SERIES_RECORD;
+
+int
+open_time_series(TIME_SERIES* series, const char* filename, int binary)
+{
+  series->file = fopen(filename, "w+");
+  if (!series->file) {
+    fprintf(stderr, "APEX_Error : Unable to open time series %s\n", filename);
+    return -1;
+  }
+  setvbuf(series->file, NULL, _IOFBF, SERIES_BUFFER_SIZE);
+  series->binary = binary;
+  series->bytes = 0;
+  series->records = 0;
+  return 0;
+}
+
+void
+close_time_series(TIME_SERIES* series)
+{
+  if (series->file) {
+    fclose(series->file);
+  }
+  series->file = NULL;
+}
+
+/* Drops records written after the series was restored to an earlier point */
+void
+rewind_time_series(TIME_SERIES* series)
+{
+  if (!series->file) {
+    return;
+  }
+  fflush(series->file);
+  if (ftruncate(fileno(series->file), series->bytes) != 0 ||
+      fseek(series->file, series->bytes, SEEK_SET) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to rewind time series\n");
+  }
+}
+
+/* Instructions of the class committed so far */
+static long
+committed_of_class(APEX_CPU* cpu, int class)
+{
+  long total = 0;
+  for (int n = 0; n < LATENCY_BINS; n++) {
+    total += cpu->latency.counts[class][SPAN_FETCH_COMMIT][n];
+  }
+  return total;
+}
+
+static long
+series_position(APEX_CPU* cpu)
+{
+  return cpu->series.by_instructions ? cpu->instructions_committed : cpu->clock;
+}
+
+/* Starts the current record at the current cycle */
+static void
+mark_record_start(APEX_CPU* cpu)
+{
+  TIME_SERIES* series = &cpu->series;
+  series->clock = cpu->clock;
+  series->committed = cpu->instructions_committed;
+  series->flushes = cpu->flushes;
+  series->loads = committed_of_class(cpu, LAT_LOAD);
+  series->stores = committed_of_class(cpu, LAT_STORE);
+  for (int s = 0; s < NUM_OCC_QUEUES; s++) {
+    series->occupancy[s] = occupancy_entry_cycles(cpu, occupancy_queues[s]);
+  }
+  series->next = (series_position(cpu) / series->interval + 1) * series->interval;
+}
+
+static void
+write_series(TIME_SERIES* series, const void* data, size_t size)
+{
+  if (fwrite(data, size, 1, series->file) != 1) {
+    fprintf(stderr, "APEX_Error : Unable to write time series\n");
+    exit(1);
+  }
+  series->bytes += size;
+}
+
+/* Writes the header and starts the first record, called once the options are known */
+void
+start_time_series(APEX_CPU* cpu)
+{
+  TIME_SERIES* series = &cpu->series;
+  if (!series->file) {
+    return;
+  }
+  if (series->interval <= 0) {
+    series->interval = SERIES_DEFAULT_INTERVAL;
+  }
+
+  if (series->binary) {
+    char header[SERIES_HEADER_SIZE];
+    int fields[4] = {SERIES_VERSION, series->by_instructions, series->interval, sizeof(SERIES_RECORD)};
+    memcpy(header, SERIES_MAGIC, 8);
+    memcpy(header + 8, fields, sizeof(fields));
+    write_series(series, header, sizeof(header));
+  }
+  else {
+    char line[] = "start,cycles,committed,ipc,flushes,loads,stores,iq,rob,lsq\n";
+    write_series(series, line, strlen(line));
+  }
+  mark_record_start(cpu);
+}
+
+/* Writes the record of the cycles since its start, up to the current one */
+static void
+write_record(APEX_CPU* cpu)
+{
+  TIME_SERIES* series = &cpu->series;
+  SERIES_RECORD record;
+  record.start = series->clock;
+  record.cycles = cpu->clock - series->clock;
+  record.committed = cpu->instructions_committed - series->committed;
+  record.flushes = cpu->flushes - series->flushes;
+  record.loads = committed_of_class(cpu, LAT_LOAD) - series->loads;
+  record.stores = committed_of_class(cpu, LAT_STORE) - series->stores;
+  for (int s = 0; s < NUM_OCC_QUEUES; s++) {
+    long used = occupancy_entry_cycles(cpu, occupancy_queues[s]) - series->occupancy[s];
+    record.occupancy[s] = record.cycles ? (float)used / record.cycles : 0.0f;
+  }
+
+  if (series->binary) {
+    write_series(series, &record, sizeof(record));
+  }
+  else {
+    char line[256];
+    int length = snprintf(line, sizeof(line), "%d,%d,%d,%.4f,%d,%d,%d,%.2f,%.2f,%.2f\n",
+                          record.start, record.cycles, record.committed,
+                          record.cycles ? (double)record.committed / record.cycles : 0.0,
+                          record.flushes, record.loads, record.stores,
+                          record.occupancy[0], record.occupancy[1], record.occupancy[2]);
+    write_series(series, line, length);
+  }
+  series->records++;
+  mark_record_start(cpu);
+}
+
+/* Writes a record if its interval ended, called after every simulated cycle */
+void
+sample_time_series(APEX_CPU* cpu)
+{
+  if (series_position(cpu) >= cpu->series.next) {
+    write_record(cpu);
+  }
+}
+
+/* Writes the interval the run stopped in */
+void
+finish_time_series(APEX_CPU* cpu)
+{
+  if (cpu->clock > cpu->series.clock) {
+    write_record(cpu);
+  }
+  fflush(cpu->series.file);
+}
+
+void
+display_time_series_stats(APEX_CPU* cpu)
+{
+  printf("\n================================= TIME SERIES ==================================\n");
+  printf("         |\tInterval\t\t|\t%d %s\t|\n", cpu->series.interval,
+         cpu->series.by_instructions ? "instructions" : "cycles");
+  printf("         |\tRecords written\t\t|\t%ld\t|\n", cpu->series.records);
+  printf("         |\tBytes written\t\t|\t%ld\t|\n", cpu->series.bytes);
+  printf("================================================================================\n");
+}
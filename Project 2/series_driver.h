@@ -0,0 +1,32 @@
+/*
+ *  series_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#define SERIES_MAGIC "APEXSERS"
+#define SERIES_VERSION 1
+#define SERIES_HEADER_SIZE 24
+
+int
+open_time_series(TIME_SERIES* series, const char* filename, int binary);
+
+void
+close_time_series(TIME_SERIES* series);
+
+void
+rewind_time_series(TIME_SERIES* series);
+
+void
+start_time_series(APEX_CPU* cpu);
+
+void
+sample_time_series(APEX_CPU* cpu);
+
+void
+finish_time_series(APEX_CPU* cpu);
+
+void
+display_time_series_stats(APEX_CPU* cpu);
@@ -0,0 +1,181 @@
+/*
+ *  stall_driver.c
+ *  Accounting of the cycles decode can not dispatch
+ *
+ *  allowed_dispatch reports the set of resources (enum STALL_CAUSES) the
+ *  instruction in decode lacks. Every cycle from then until the next report
+ *  is charged to that set, so a cycle in which the ROB and the URF are both
+ *  full counts for both. Charging on the next report keeps the counts exact
+ *  when the scheduler skips the cycles decode waits in.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "stall_driver.h"
+
+static const char* stall_cause_names[NUM_STALL_CAUSES] = {"ROB", "IQ", "URF", "LSQ", "BIS"};
+
+void
+init_dispatch_stalls(APEX_CPU* cpu)
+{
+  memset(&cpu->stalls, 0, sizeof(cpu->stalls));
+}
+
+/* Charges the cycles of the current mask up to the given clock */
+static void
+settle_stalls(DISPATCH_STALLS* stalls, int clock)
+{
+  if (stalls->mask && clock > stalls->since) {
+    stalls->cycles[stalls->mask] += clock - stalls->since;
+  }
+  stalls->since = clock;
+}
+
+/* Called with the resources decode lacks in this cycle, 0 once it dispatches or is flushed */
+void
+note_dispatch_stall(APEX_CPU* cpu, int mask)
+{
+  settle_stalls(&cpu->stalls, cpu->clock);
+  cpu->stalls.mask = mask;
+}
+
+/* Returns the cycles in which the resource was among the lacking ones */
+static long
+cause_cycles(long* cycles, int cause)
+{
+  long total = 0;
+  for (int mask = 1; mask < STALL_MASKS_NUMBER; mask++) {
+    if (mask & (1 << cause)) {
+      total += cycles[mask];
+    }
+  }
+  return total;
+}
+
+static long
+stalled_cycles(long* cycles)
+{
+  long total = 0;
+  for (int mask = 1; mask < STALL_MASKS_NUMBER; mask++) {
+    total += cycles[mask];
+  }
+  return total;
+}
+
+/* Called at every loop head, so the cycles of the last iteration are known */
+void
+mark_loop_stalls(APEX_CPU* cpu)
+{
+  DISPATCH_STALLS* stalls = &cpu->stalls;
+  settle_stalls(stalls, cpu->clock);
+  for (int mask = 0; mask < STALL_MASKS_NUMBER; mask++) {
+    stalls->loop_period[mask] = stalls->cycles[mask] - stalls->loop_mark[mask];
+    stalls->loop_mark[mask] = stalls->cycles[mask];
+  }
+}
+
+/* Charges iterations skipped by the loop fast-forward like the last detailed one */
+void
+skip_loop_stalls(APEX_CPU* cpu, int iterations)
+{
+  DISPATCH_STALLS* stalls = &cpu->stalls;
+  settle_stalls(stalls, cpu->clock);
+  for (int mask = 0; mask < STALL_MASKS_NUMBER; mask++) {
+    stalls->cycles[mask] += stalls->loop_period[mask] * iterations;
+  }
+}
+
+/* Starts interval reports with the current cycle, the interval is set by main */
+void
+start_stall_intervals(APEX_CPU* cpu)
+{
+  DISPATCH_STALLS* stalls = &cpu->stalls;
+  if (stalls->interval <= 0) {
+    return;
+  }
+  settle_stalls(stalls, cpu->clock);
+  memcpy(stalls->report_mark, stalls->cycles, sizeof(stalls->cycles));
+  stalls->next_report = ((cpu->clock - 1) / stalls->interval + 1) * stalls->interval;
+}
+
+/* Prints the stalls of the cycles since the last report, which end with the given one */
+static void
+print_stall_interval(DISPATCH_STALLS* stalls, int start, int end)
+{
+  settle_stalls(stalls, end + 1);
+
+  long cycles[STALL_MASKS_NUMBER];
+  for (int mask = 0; mask < STALL_MASKS_NUMBER; mask++) {
+    cycles[mask] = stalls->cycles[mask] - stalls->report_mark[mask];
+    stalls->report_mark[mask] = stalls->cycles[mask];
+  }
+  printf("STALLS %d-%d |\tstalled %ld", start, end, stalled_cycles(cycles));
+  for (int cause = 0; cause < NUM_STALL_CAUSES; cause++) {
+    printf("\t| %s %ld", stall_cause_names[cause], cause_cycles(cycles, cause));
+  }
+  printf("\t|\n");
+}
+
+/* Prints a row for every interval that ended, called between cycles */
+void
+report_stall_interval(APEX_CPU* cpu)
+{
+  DISPATCH_STALLS* stalls = &cpu->stalls;
+  if (stalls->interval <= 0) {
+    return;
+  }
+  while (cpu->clock > stalls->next_report) {
+    print_stall_interval(stalls, stalls->next_report - stalls->interval + 1, stalls->next_report);
+    stalls->next_report += stalls->interval;
+  }
+  settle_stalls(stalls, cpu->clock);
+}
+
+/* Prints the interval the run stopped in */
+void
+finish_stall_intervals(APEX_CPU* cpu)
+{
+  DISPATCH_STALLS* stalls = &cpu->stalls;
+  int start = stalls->next_report - stalls->interval + 1;
+  if (stalls->interval > 0 && cpu->clock > start) {
+    print_stall_interval(stalls, start, cpu->clock - 1);
+  }
+}
+
+void
+display_stall_stats(APEX_CPU* cpu)
+{
+  long* cycles = cpu->stalls.cycles;
+  settle_stalls(&cpu->stalls, cpu->clock);
+
+  printf("\n=============================== DISPATCH STALLS ================================\n");
+  printf("         |\tStalled cycles\t\t|\t%ld\t|\n", stalled_cycles(cycles));
+  for (int cause = 0; cause < NUM_STALL_CAUSES; cause++) {
+    printf("         |\t%s full\t\t|\t%ld\t|\n", stall_cause_names[cause], cause_cycles(cycles, cause));
+  }
+
+  /* Cycles in which more than one resource was lacking */
+  for (int mask = 1; mask < STALL_MASKS_NUMBER; mask++) {
+    if (!cycles[mask] || !(mask & (mask - 1))) {
+      continue;
+    }
+    char names[64] = "";
+    for (int cause = 0; cause < NUM_STALL_CAUSES; cause++) {
+      if (mask & (1 << cause)) {
+        if (names[0]) {
+          strcat(names, " + ");
+        }
+        strcat(names, stall_cause_names[cause]);
+      }
+    }
+    printf("         |\t%s\t\t|\t%ld\t|\n", names, cycles[mask]);
+  }
+  printf("================================================================================\n");
+}
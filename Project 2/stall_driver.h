@@ -0,0 +1,31 @@
+/*
+ *  stall_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+void
+init_dispatch_stalls(APEX_CPU* cpu);
+
+void
+note_dispatch_stall(APEX_CPU* cpu, int mask);
+
+void
+mark_loop_stalls(APEX_CPU* cpu);
+
+void
+skip_loop_stalls(APEX_CPU* cpu, int iterations);
+
+void
+start_stall_intervals(APEX_CPU* cpu);
+
+void
+report_stall_interval(APEX_CPU* cpu);
+
+void
+finish_stall_intervals(APEX_CPU* cpu);
+
+void
+display_stall_stats(APEX_CPU* cpu);
@@ -0,0 +1,142 @@
+/*
+ *  topdown_driver.c
+ *  Top-down accounting of commit slots
+ *
+ *  Every cycle has COMMIT_WIDTH commit slots. Slots an instruction left the
+ *  ROB in are retiring. The others are lost, and are charged as:
+ *    bad speculation  from a flush until an instruction fetched after it is
+ *                     at the ROB head, and then one slot per ROB entry the
+ *                     flush removed, as those entries took a slot of the ROB
+ *                     that never retired
+ *    frontend bound   the ROB is empty, fetch is empty or stalled
+ *    memory bound     the head is LOAD or STORE
+ *    core bound       the head is MUL (Mul_FU) or any other instruction (Int_FU)
+ *
+ *  Nothing commits and the ROB does not change in the cycles the scheduler
+ *  skips, so they are charged like the cycle before them.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "topdown_driver.h"
+
+void
+init_top_down(APEX_CPU* cpu)
+{
+  memset(&cpu->topdown, 0, sizeof(cpu->topdown));
+}
+
+/* Called by control_flow before the flush, instructions fetched until now are on the wrong path or older */
+void
+note_top_down_flush(APEX_CPU* cpu)
+{
+  TOP_DOWN* topdown = &cpu->topdown;
+  long branch_sequence = cpu->stage[Int_FU].sequence;
+  for (int i = 0; i < ROB_ENTRIES_NUMBER; i++) {
+    if (!cpu->rob.rob_entry[i].free && cpu->rob.rob_entry[i].sequence > branch_sequence) {
+      topdown->squashed++;
+    }
+  }
+  topdown->recovering = 1;
+  topdown->recovery_sequence = cpu->pipeview.sequence;
+}
+
+static enum TOP_DOWN_CATEGORIES
+get_backend_category(ROB_Entry* head)
+{
+  int opcode_id = get_opcode_id(head->opcode);
+  if (opcode_id == OP_LOAD || opcode_id == OP_STORE) {
+    return TD_MEMORY;
+  }
+  return opcode_id == OP_MUL ? TD_CORE_MUL : TD_CORE_INT;
+}
+
+/* Called at the end of every simulated cycle, which holds for the given number of cycles */
+void
+account_top_down(APEX_CPU* cpu, int cycles)
+{
+  TOP_DOWN* topdown = &cpu->topdown;
+  int retired = cpu->instructions_committed - topdown->committed;
+  if (retired > COMMIT_WIDTH) {
+    retired = COMMIT_WIDTH;
+  }
+  topdown->committed = cpu->instructions_committed;
+  topdown->slots[TD_RETIRING] += retired;
+
+  long lost = (long)COMMIT_WIDTH * cycles - retired;
+  ROB_Entry* head = &cpu->rob.rob_entry[cpu->rob.head];
+  if (topdown->recovering && !head->free && head->sequence >= topdown->recovery_sequence) {
+    topdown->recovering = 0;
+  }
+  if (topdown->recovering) {
+    topdown->slots[TD_BAD_SPECULATION] += lost;
+    return;
+  }
+
+  long squashed = lost < topdown->squashed ? lost : topdown->squashed;
+  topdown->slots[TD_BAD_SPECULATION] += squashed;
+  topdown->squashed -= squashed;
+  lost -= squashed;
+  topdown->slots[head->free ? TD_FRONTEND : get_backend_category(head)] += lost;
+}
+
+/* Called at every loop head, so the slots of the last iteration are known */
+void
+mark_loop_top_down(APEX_CPU* cpu)
+{
+  TOP_DOWN* topdown = &cpu->topdown;
+  for (int c = 0; c < NUM_TD_CATEGORIES; c++) {
+    topdown->loop_period[c] = topdown->slots[c] - topdown->loop_mark[c];
+    topdown->loop_mark[c] = topdown->slots[c];
+  }
+}
+
+/*
+ * Charges iterations skipped by the loop fast-forward like the last detailed
+ * one. Their instructions are committed by fast_forward_loop, not in a cycle.
+ */
+void
+skip_loop_top_down(APEX_CPU* cpu, int iterations)
+{
+  TOP_DOWN* topdown = &cpu->topdown;
+  for (int c = 0; c < NUM_TD_CATEGORIES; c++) {
+    topdown->slots[c] += topdown->loop_period[c] * iterations;
+  }
+  topdown->committed += iterations * cpu->loop.period_instructions;
+}
+
+static void
+print_category(const char* name, long slots, long total)
+{
+  printf("         |\t%s|\t%ld\t|\t%.1f%%\t|\n", name, slots, total ? 100.0 * slots / total : 0.0);
+}
+
+void
+display_top_down_stats(APEX_CPU* cpu)
+{
+  long* slots = cpu->topdown.slots;
+  long total = 0;
+  for (int c = 0; c < NUM_TD_CATEGORIES; c++) {
+    total += slots[c];
+  }
+  long core = slots[TD_CORE_MUL] + slots[TD_CORE_INT];
+
+  printf("\n=================================== TOP-DOWN ===================================\n");
+  printf("         |\tCommit slots\t\t|\t%ld\t|\t%d wide\t|\n", total, COMMIT_WIDTH);
+  print_category("Retiring\t\t", slots[TD_RETIRING], total);
+  print_category("Frontend bound\t\t", slots[TD_FRONTEND], total);
+  print_category("Bad speculation\t\t", slots[TD_BAD_SPECULATION], total);
+  print_category("Backend bound\t\t", slots[TD_MEMORY] + core, total);
+  print_category("  Memory bound\t\t", slots[TD_MEMORY], total);
+  print_category("  Core bound\t\t", core, total);
+  print_category("    Mul_FU\t\t", slots[TD_CORE_MUL], total);
+  print_category("    Int_FU\t\t", slots[TD_CORE_INT], total);
+  printf("================================================================================\n");
+}
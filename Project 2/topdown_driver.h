@@ -0,0 +1,25 @@
+/*
+ *  topdown_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+void
+init_top_down(APEX_CPU* cpu);
+
+void
+note_top_down_flush(APEX_CPU* cpu);
+
+void
+account_top_down(APEX_CPU* cpu, int cycles);
+
+void
+mark_loop_top_down(APEX_CPU* cpu);
+
+void
+skip_loop_top_down(APEX_CPU* cpu, int iterations);
+
+void
+display_top_down_stats(APEX_CPU* cpu);
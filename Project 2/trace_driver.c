@@ -0,0 +1,402 @@
+/*
+ *  trace_driver.c
+ *  Compact binary trace of committed instructions
+ *
+ *  The trace file starts with a header of TRACE_HEADER_SIZE bytes: the magic
+ *  "APEXTRCE", the format version and a reserved int. Records follow, one per
+ *  instruction in commit order:
+ *
+ *    byte      opcode id in the low 5 bits, and the flags
+ *                TRACE_JUMPED  PC is not the PC of the previous record + 4
+ *                TRACE_TAKEN   branch redirected the PC
+ *                TRACE_VALUE   instruction wrote a register
+ *    varint    PC - (previous PC + 4), only with TRACE_JUMPED
+ *    varint    value written to the destination register, only with TRACE_VALUE
+ *    varint    effective address - previous effective address, LOAD and STORE only
+ *
+ *  Varints are little endian groups of 7 bits, the high bit set in all but the
+ *  last byte. Signed numbers are zigzag encoded first, so small negative deltas
+ *  stay short. Most records take 1 - 3 bytes.
+ *
+ *  Records are encoded into one of two large blocks. A full block is handed to
+ *  a writer thread while the simulator fills the other one, so the simulation
+ *  only waits for the disk when it outruns it.
+ *
+ *  Traces are read back from a read-only shared mapping, records are decoded
+ *  in place without copying the file.
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cpu.h"
+#include "trace_driver.h"
+
+#define TRACE_BLOCK_SIZE (1 << 20)
+#define TRACE_RECORD_MAX_SIZE 16    // opcode byte and three varints of at most 5 bytes
+
+struct TRACE_WRITER
+{
+  int fd;
+  unsigned char* block[2];
+  int current;    // block being filled by the simulator
+  long fill;    // bytes in the current block
+  int pending;    // block handed to the thread, -1 if none
+  long pending_size;
+  int stop;
+  int failed;    // a write to the file failed
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+static int
+write_all(int fd, const unsigned char* data, long size)
+{
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written <= 0) {
+      return -1;
+    }
+    data += written;
+    size -= written;
+  }
+  return 0;
+}
+
+/* Writes the blocks handed over by the simulator until it is closed */
+static void*
+writer_thread(void* argument)
+{
+  struct TRACE_WRITER* writer = argument;
+  pthread_mutex_lock(&writer->lock);
+  for (;;) {
+    while (writer->pending == -1 && !writer->stop) {
+      pthread_cond_wait(&writer->cond, &writer->lock);
+    }
+    if (writer->pending == -1) {
+      break;
+    }
+    int block = writer->pending;
+    long size = writer->pending_size;
+    pthread_mutex_unlock(&writer->lock);
+
+    int failed = write_all(writer->fd, writer->block[block], size);
+
+    pthread_mutex_lock(&writer->lock);
+    writer->failed |= failed;
+    writer->pending = -1;
+    pthread_cond_broadcast(&writer->cond);
+  }
+  pthread_mutex_unlock(&writer->lock);
+  return NULL;
+}
+
+/* Waits until the thread has written the block it was handed */
+static void
+wait_for_writer(struct TRACE_WRITER* writer)
+{
+  pthread_mutex_lock(&writer->lock);
+  while (writer->pending != -1) {
+    pthread_cond_wait(&writer->cond, &writer->lock);
+  }
+  pthread_mutex_unlock(&writer->lock);
+}
+
+/* Hands the current block to the thread and continues in the other one */
+static void
+submit_block(struct TRACE_WRITER* writer)
+{
+  if (!writer->fill) {
+    return;
+  }
+  wait_for_writer(writer);
+  pthread_mutex_lock(&writer->lock);
+  writer->pending = writer->current;
+  writer->pending_size = writer->fill;
+  pthread_cond_broadcast(&writer->cond);
+  pthread_mutex_unlock(&writer->lock);
+  writer->current ^= 1;
+  writer->fill = 0;
+}
+
+int
+open_commit_trace(COMMIT_TRACE* trace, const char* filename)
+{
+  memset(trace, 0, sizeof(*trace));
+  trace->last_pc = 4000 - 4;
+
+  struct TRACE_WRITER* writer = calloc(1, sizeof(*writer));
+  unsigned char* blocks = malloc(2 * TRACE_BLOCK_SIZE);
+  if (!writer || !blocks) {
+    fprintf(stderr, "APEX_Error : Unable to allocate commit trace buffers\n");
+    free(writer);
+    free(blocks);
+    return -1;
+  }
+  writer->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (writer->fd < 0) {
+    fprintf(stderr, "APEX_Error : Unable to open commit trace %s\n", filename);
+    free(writer);
+    free(blocks);
+    return -1;
+  }
+
+  char header[TRACE_HEADER_SIZE];
+  int version = TRACE_VERSION;
+  memset(header, 0, sizeof(header));
+  memcpy(header, TRACE_MAGIC, 8);
+  memcpy(header + 8, &version, sizeof(version));
+  if (write_all(writer->fd, (unsigned char*)header, sizeof(header))) {
+    fprintf(stderr, "APEX_Error : Unable to write commit trace %s\n", filename);
+    close(writer->fd);
+    free(writer);
+    free(blocks);
+    return -1;
+  }
+
+  writer->block[0] = blocks;
+  writer->block[1] = blocks + TRACE_BLOCK_SIZE;
+  writer->pending = -1;
+  pthread_mutex_init(&writer->lock, NULL);
+  pthread_cond_init(&writer->cond, NULL);
+  if (pthread_create(&writer->thread, NULL, writer_thread, writer) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to start commit trace writer\n");
+    close(writer->fd);
+    free(writer);
+    free(blocks);
+    return -1;
+  }
+  trace->writer = writer;
+  return 0;
+}
+
+void
+close_commit_trace(COMMIT_TRACE* trace)
+{
+  struct TRACE_WRITER* writer = trace->writer;
+  if (!writer) {
+    return;
+  }
+  submit_block(writer);
+  pthread_mutex_lock(&writer->lock);
+  writer->stop = 1;
+  pthread_cond_broadcast(&writer->cond);
+  pthread_mutex_unlock(&writer->lock);
+  pthread_join(writer->thread, NULL);
+
+  if (writer->failed || close(writer->fd) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to write commit trace\n");
+  }
+  pthread_mutex_destroy(&writer->lock);
+  pthread_cond_destroy(&writer->cond);
+  free(writer->block[0]);
+  free(writer);
+  trace->writer = NULL;
+}
+
+/* Drops records written after the trace position was restored to an earlier one */
+void
+rewind_commit_trace(COMMIT_TRACE* trace)
+{
+  struct TRACE_WRITER* writer = trace->writer;
+  if (!writer) {
+    return;
+  }
+  submit_block(writer);
+  wait_for_writer(writer);
+  off_t size = TRACE_HEADER_SIZE + trace->bytes;
+  if (ftruncate(writer->fd, size) != 0 || lseek(writer->fd, size, SEEK_SET) != size) {
+    fprintf(stderr, "APEX_Error : Unable to rewind commit trace\n");
+  }
+}
+
+static unsigned char*
+put_varint(unsigned char* out, unsigned int value)
+{
+  while (value >= 0x80) {
+    *out++ = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  *out++ = value;
+  return out;
+}
+
+static unsigned char*
+put_signed(unsigned char* out, int value)
+{
+  return put_varint(out, ((unsigned int)value << 1) ^ (unsigned int)(value >> 31));
+}
+
+void
+trace_instruction(COMMIT_TRACE* trace, TRACE_RECORD* record)
+{
+  struct TRACE_WRITER* writer = trace->writer;
+  if (writer->fill + TRACE_RECORD_MAX_SIZE > TRACE_BLOCK_SIZE) {
+    submit_block(writer);
+  }
+
+  unsigned char* start = writer->block[writer->current] + writer->fill;
+  unsigned char* out = start + 1;
+  int jumped = record->pc != trace->last_pc + 4;
+  *start = (record->opcode_id & TRACE_OPCODE_MASK) |
+           (jumped ? TRACE_JUMPED : 0) |
+           (record->taken ? TRACE_TAKEN : 0) |
+           (record->has_value ? TRACE_VALUE : 0);
+  if (jumped) {
+    out = put_signed(out, record->pc - (trace->last_pc + 4));
+  }
+  if (record->has_value) {
+    out = put_signed(out, record->value);
+  }
+  if (record->opcode_id == OP_LOAD || record->opcode_id == OP_STORE) {
+    out = put_signed(out, record->address - trace->last_address);
+    trace->last_address = record->address;
+  }
+  trace->last_pc = record->pc;
+
+  writer->fill += out - start;
+  trace->bytes += out - start;
+  trace->records++;
+}
+
+/* Records the instruction at the ROB head as it commits */
+void
+trace_rob_entry(APEX_CPU* cpu, ROB_Entry* entry)
+{
+  TRACE_RECORD record;
+  record.pc = entry->pc;
+  record.opcode_id = get_opcode_id(entry->opcode);
+  record.has_value = entry->phys_rd != -1;
+  record.value = record.has_value ? cpu->urf[entry->phys_rd].value : 0;
+  record.address = entry->mem_address;
+  record.taken = entry->taken;
+  trace_instruction(&cpu->trace, &record);
+}
+
+/*
+ * Maps a trace file read-only and checks its header. Returns the start of
+ * the mapping and its size, or NULL. Mappings of the same file share the
+ * page cache, so concurrent replays do not copy the trace.
+ */
+const unsigned char*
+map_commit_trace(const char* filename, long* size)
+{
+  int fd = open(filename, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to open commit trace %s\n", filename);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return NULL;
+  }
+
+  int version = 0;
+  void* map = MAP_FAILED;
+  if (st.st_size >= TRACE_HEADER_SIZE) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (map != MAP_FAILED) {
+    memcpy(&version, (char*)map + 8, sizeof(version));
+  }
+  if (map == MAP_FAILED || memcmp(map, TRACE_MAGIC, 8) != 0 || version != TRACE_VERSION) {
+    fprintf(stderr, "APEX_Error : %s is not a commit trace of version %d\n", filename, TRACE_VERSION);
+    if (map != MAP_FAILED) {
+      munmap(map, st.st_size);
+    }
+    return NULL;
+  }
+  /* Records are read front to back */
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+  *size = st.st_size;
+  return map;
+}
+
+void
+unmap_commit_trace(const unsigned char* trace, long size)
+{
+  munmap((void*)trace, size);
+}
+
+void
+init_trace_reader(TRACE_READER* reader, const unsigned char* trace, long size)
+{
+  reader->data = trace + TRACE_HEADER_SIZE;
+  reader->size = size - TRACE_HEADER_SIZE;
+  reader->offset = 0;
+  reader->last_pc = 4000 - 4;
+  reader->last_address = 0;
+}
+
+/* Reads a varint, a record cut off by the end leaves offset past size */
+static unsigned int
+get_varint(TRACE_READER* reader)
+{
+  unsigned int value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (reader->offset >= reader->size) {
+      reader->offset = reader->size + 1;
+      return 0;
+    }
+    unsigned char byte = reader->data[reader->offset++];
+    value |= (unsigned int)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+  return value;
+}
+
+static int
+get_signed(TRACE_READER* reader)
+{
+  unsigned int value = get_varint(reader);
+  return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+/* Decodes the next record. Returns 1, or 0 at the end of the trace */
+int
+read_trace_record(TRACE_READER* reader, TRACE_RECORD* record)
+{
+  if (reader->offset >= reader->size) {
+    return 0;
+  }
+  unsigned char first = reader->data[reader->offset++];
+  record->opcode_id = first & TRACE_OPCODE_MASK;
+  record->taken = (first & TRACE_TAKEN) != 0;
+  record->has_value = (first & TRACE_VALUE) != 0;
+  record->pc = reader->last_pc + 4;
+  if (first & TRACE_JUMPED) {
+    record->pc += get_signed(reader);
+  }
+  record->value = record->has_value ? get_signed(reader) : 0;
+  record->address = 0;
+  if (record->opcode_id == OP_LOAD || record->opcode_id == OP_STORE) {
+    record->address = reader->last_address + get_signed(reader);
+    reader->last_address = record->address;
+  }
+  reader->last_pc = record->pc;
+  return reader->offset <= reader->size;
+}
+
+void
+display_trace_stats(APEX_CPU* cpu)
+{
+  printf("\n================================= COMMIT TRACE =================================\n");
+  printf("         |\tRecords written\t|\t%ld\t|\n", cpu->trace.records);
+  printf("         |\tBytes per record\t|\t%.2f\t|\n",
+         cpu->trace.records ? (double)cpu->trace.bytes / cpu->trace.records : 0.0);
+  printf("================================================================================\n");
+}
@@ -0,0 +1,47 @@
+/*
+ *  trace_driver.h
+ *
+ *  Author :
+ *  Ulugbek Ergashev (uergash1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+
+#define TRACE_MAGIC "APEXTRCE"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 16
+
+/* First byte of a record */
+#define TRACE_OPCODE_MASK 0x1f
+#define TRACE_JUMPED 0x20
+#define TRACE_TAKEN 0x40
+#define TRACE_VALUE 0x80
+
+int
+open_commit_trace(COMMIT_TRACE* trace, const char* filename);
+
+void
+close_commit_trace(COMMIT_TRACE* trace);
+
+void
+rewind_commit_trace(COMMIT_TRACE* trace);
+
+void
+trace_instruction(COMMIT_TRACE* trace, TRACE_RECORD* record);
+
+void
+trace_rob_entry(APEX_CPU* cpu, ROB_Entry* entry);
+
+void
+display_trace_stats(APEX_CPU* cpu);
+
+const unsigned char*
+map_commit_trace(const char* filename, long* size);
+
+void
+unmap_commit_trace(const unsigned char* trace, long size);
+
+void
+init_trace_reader(TRACE_READER* reader, const unsigned char* trace, long size);
+
+int
+read_trace_record(TRACE_READER* reader, TRACE_RECORD* record);